@@ -0,0 +1,30 @@
+/*
+ * Registers the kernel from BENCH_H under the name BENCH_NAME. This
+ * file is compiled once for every kernel.
+ */
+#include "kernel.h"
+#include <stdint.h>
+#include <sys/auxv.h>
+
+#include BENCH_H
+
+static bool supported(void)
+{
+#if defined(BENCH_ISA)
+    return __builtin_cpu_supports(BENCH_ISA);
+#elif defined(BENCH_HWCAP)
+    return (getauxval(AT_HWCAP) & BENCH_HWCAP) != 0;
+#else
+    return true;
+#endif
+}
+
+static const struct kernel kernel = {
+    .name = BENCH_NAME,
+    .func = bench_func,
+    .supported = supported,
+};
+
+// Pointers (unlike structs) are not padded by the compiler, so the
+// section forms an array
+static const struct kernel *kernel_ptr __attribute__((used, section("instr_kernels"))) = &kernel;
@@ -0,0 +1,22 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include <stdbool.h>
+
+// Benchmark kernel registered by kernel.c. Pointers to all kernels
+// linked into a program are stored in the "instr_kernels" section.
+struct kernel {
+    const char *name;
+    int (*func)(void); // Returns the number of executed operations
+    bool (*supported)(void); // Whether the CPU supports the kernel's instructions
+};
+
+extern const struct kernel *const __start_instr_kernels[], *const __stop_instr_kernels[];
+
+#define kernel_count() (__stop_instr_kernels - __start_instr_kernels)
+
+#define for_each_kernel(k)                                                                                             \
+    for (const struct kernel *const *k##_p = __start_instr_kernels, *k;                                                \
+         k##_p < __stop_instr_kernels && (k = *k##_p); k##_p++)
+
+#endif
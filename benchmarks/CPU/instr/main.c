@@ -1,5 +1,7 @@
 #define _GNU_SOURCE
-#include "bench.h"
+#include "cpulist.h"
+#include "kernel.h"
+#include "pwm.h"
 #include <err.h>
 #include <errno.h>
 #include <limits.h>
@@ -21,39 +23,58 @@
 #define demos_completed()
 #endif
 
-#include BENCH_H
-
 #define MS_TO_NANO 1000000
 #define SEC_TO_NANO 1000000000
 
-pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
-static int idle_thread = -1;
+// Duty cycle control of each CPU (NULL = run all the time), indexed
+// by CPU ID
+static struct pwm **cpu_pwm;
+
 // ID of first spawned benchmark thread
 static int first_thread_id = -1;
 static bool demos_enabled = false;
 
 int loops_per_print = 1000000;
 
+// Reporter mode (-i): Threads only update their counters, which are
+// printed by reporter_thread. Each counter has its own cache line.
+static long report_interval_ms = 0;
+static struct counter {
+    uint64_t work_done;
+} __attribute__((aligned(64))) * counters;
+static cpu_set_t *running;
+
+// Kernel executed by benchmark threads; changed by schedule_thread
+static const struct kernel *current_kernel;
+
+// Kernels to run one after another (-k)
+struct step {
+    const struct kernel *kernel;
+    double seconds; // 0 means forever
+};
+static struct step *schedule;
+static int schedule_len;
+
 void *benchmark_loop(void *ptr)
 {
     int thread_id = (intptr_t)ptr;
     uint64_t cpu_work_done = 0;
+    struct pwm *pwm = cpu_pwm[thread_id];
+    uint64_t *counter = report_interval_ms ? &counters[thread_id].work_done : NULL;
 
     while (1) {
         for (int j = 0; j < loops_per_print || loops_per_print < 1; ++j) {
 
-            if (idle_thread != -1) { /* if period was defined */
-                /* Do I need a lock here? Or can I handle one more iteration with idle_thread = 0 after the signal? */
-                pthread_mutex_lock(&mutex);
-                while (idle_thread == 1)
-                    pthread_cond_wait(&cond, &mutex);
-                pthread_mutex_unlock(&mutex);
-            }
-            cpu_work_done += bench_func();
+            if (pwm)
+                pwm_check(pwm);
+            cpu_work_done += __atomic_load_n(&current_kernel, __ATOMIC_RELAXED)->func();
+            if (counter)
+                __atomic_store_n(counter, cpu_work_done, __ATOMIC_RELAXED);
+        }
+        if (!counter) {
+            printf("CPU%d_work_done=%lu\n", thread_id, cpu_work_done);
+            fflush(stdout);
         }
-        printf("CPU%d_work_done=%lu\n", thread_id, cpu_work_done);
-        fflush(stdout);
         // seems most sensible after printf, so that we see the progress before suspending
         if (demos_enabled && thread_id == first_thread_id) {
             demos_completed();
@@ -62,6 +83,25 @@ void *benchmark_loop(void *ptr)
     return NULL;
 }
 
+// Print work done by all threads every report_interval_ms
+void *reporter_thread(void *ptr)
+{
+    struct timespec next;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (1) {
+        next.tv_sec += (next.tv_nsec + report_interval_ms * MS_TO_NANO) / SEC_TO_NANO;
+        next.tv_nsec = (next.tv_nsec + report_interval_ms * MS_TO_NANO) % SEC_TO_NANO;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        for (int i = 0; i < cpulist_max_cpus(); i++)
+            if (CPU_ISSET_S(i, cpulist_setsize(), running))
+                printf("CPU%d_work_done=%lu\n", i, __atomic_load_n(&counters[i].work_done, __ATOMIC_RELAXED));
+        fflush(stdout);
+    }
+    return NULL;
+}
+
 long int xstrtol(const char *str, char *err_msg)
 {
     long int val;
@@ -86,29 +126,140 @@ long int xstrtol(const char *str, char *err_msg)
     return val;
 }
 
-void timespec_add_ms(struct timespec *ts, int ms)
+static const struct kernel *find_kernel(const char *name)
+{
+    for_each_kernel(k) {
+        if (strcmp(k->name, name) == 0) {
+            if (!k->supported())
+                errx(1, "Kernel %s is not supported by this CPU", name);
+            return k;
+        }
+    }
+    errx(1, "Unknown kernel: %s (use -L to list kernels)", name);
+}
+
+static int compare_kernels(const void *a, const void *b)
+{
+    return strcmp((*(const struct kernel **)a)->name, (*(const struct kernel **)b)->name);
+}
+
+static void list_kernels()
+{
+    int n = kernel_count();
+    const struct kernel *sorted[n];
+    int i = 0;
+
+    for_each_kernel(k) {
+        sorted[i++] = k;
+    }
+    qsort(sorted, n, sizeof(sorted[0]), compare_kernels);
+
+    printf("%-32s %s\n", "KERNEL", "OPS/CALL");
+    for (i = 0; i < n; i++) {
+        if (sorted[i]->supported())
+            printf("%-32s %d\n", sorted[i]->name, sorted[i]->func());
+        else
+            printf("%-32s unsupported\n", sorted[i]->name);
+    }
+}
+
+// Parse KERNEL[:SECONDS][,KERNEL[:SECONDS]...]
+static void parse_schedule(char *spec)
 {
-    ts->tv_sec += ((ts->tv_nsec) + (long long)ms * MS_TO_NANO) / SEC_TO_NANO;
-    ts->tv_nsec = ((ts->tv_nsec) + (long long)ms * MS_TO_NANO) % SEC_TO_NANO;
+    char *saveptr;
+
+    for (char *tok = strtok_r(spec, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)) {
+        schedule = realloc(schedule, (schedule_len + 1) * sizeof(*schedule));
+        if (!schedule)
+            err(1, "realloc");
+        char *colon = strchr(tok, ':');
+        double seconds = 0;
+        if (colon) {
+            char *end;
+            *colon = '\0';
+            seconds = strtod(colon + 1, &end);
+            if (end == colon + 1 || *end || seconds <= 0)
+                errx(1, "-k: Invalid duration of kernel %s: %s", tok, colon + 1);
+        }
+        schedule[schedule_len++] = (struct step){ find_kernel(tok), seconds };
+    }
+    if (schedule_len == 0)
+        errx(1, "-k: No kernel specified");
+}
+
+static void announce_kernel(const struct kernel *k)
+{
+    // Allows per-kernel statistics with thermobench --phases
+    printf("@phase=%s\n", k->name);
+    fflush(stdout);
+}
+
+// Switch kernels according to the schedule. After the last step, the
+// schedule repeats from the beginning unless the last step has no
+// duration.
+void *schedule_thread(void *ptr)
+{
+    struct timespec next;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (int i = 0; schedule[i].seconds > 0; i = (i + 1) % schedule_len) {
+        next.tv_sec += (time_t)schedule[i].seconds;
+        next.tv_nsec += (schedule[i].seconds - (time_t)schedule[i].seconds) * SEC_TO_NANO;
+        if (next.tv_nsec >= SEC_TO_NANO) {
+            next.tv_sec++;
+            next.tv_nsec -= SEC_TO_NANO;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        const struct kernel *k = schedule[(i + 1) % schedule_len].kernel;
+        __atomic_store_n(&current_kernel, k, __ATOMIC_RELAXED);
+        announce_kernel(k);
+    }
+    return NULL;
 }
 
 int main(int argc, char *argv[])
 {
-    const int num_proc = sysconf(_SC_NPROCESSORS_CONF);
-    unsigned cpu_mask = 0xffffffff;
+    const size_t setsize = cpulist_setsize();
+    cpu_set_t *cpus = cpulist_affinity();
     int opt;
 
     /* timer stuff*/
     long period_ms = 0;
     long utilization_ratio = 100;
 
-    while ((opt = getopt(argc, argv, "l:m:p:u:")) != -1) {
+    char *kernels = NULL;
+    char *profiles[32];
+    int n_profiles = 0;
+
+    while ((opt = getopt(argc, argv, "i:k:Ll:m:P:p:u:")) != -1) {
         switch (opt) {
+        case 'i':
+            report_interval_ms = xstrtol(optarg, "-i");
+            if (report_interval_ms <= 0)
+                errx(1, "-i: Interval must be positive");
+            break;
+        case 'k':
+            kernels = optarg;
+            break;
+        case 'L':
+            list_kernels();
+            exit(0);
         case 'l':
             loops_per_print = xstrtol(optarg, "-l");
             break;
-        case 'm':
-            cpu_mask = xstrtol(optarg, "-m");
+        case 'm': {
+            cpu_set_t *m = cpulist_parse_compat(optarg, "-m");
+            CPU_AND_S(setsize, cpus, cpus, m);
+            CPU_FREE(m);
+            if (CPU_COUNT_S(setsize, cpus) == 0)
+                errx(1, "-m: No allowed CPU in %s", optarg);
+            break;
+        }
+        case 'P':
+            if (n_profiles == 32)
+                errx(1, "Too many profiles");
+            profiles[n_profiles++] = optarg;
             break;
         case 'p':
             period_ms = xstrtol(optarg, "-p");
@@ -117,15 +268,69 @@ int main(int argc, char *argv[])
             utilization_ratio = xstrtol(optarg, "-u");
             break;
         default: /* '?' */
-            fprintf(stderr, "Usage: %s [-l loops ] [-m cpu_mask]\n", argv[0]);
+            fprintf(stderr,
+                    "Usage: %s [-k kernel[:seconds][,...]] [-L] [-i interval_ms | -l loops] [-m cpu_list] [-p period_ms] "
+                    "[-u utilization | -P profile[:cpu_list] ...]\n"
+                    "cpu_list is e.g. 0-3,8 or a hexadecimal mask 0xff; decimal masks are not accepted\n",
+                    argv[0]);
             exit(1);
         }
     }
 
+    if (kernels) {
+        parse_schedule(kernels);
+    } else if (kernel_count() == 1) {
+        schedule_len = 1;
+        schedule = malloc(sizeof(*schedule));
+        if (!schedule)
+            err(1, "malloc");
+        schedule[0] = (struct step){ find_kernel(__start_instr_kernels[0]->name), 0 };
+    } else {
+        errx(1, "Select kernel with -k (use -L to list kernels)");
+    }
+    current_kernel = schedule[0].kernel;
+    if (schedule_len > 1) {
+        pthread_t tid;
+        announce_kernel(current_kernel);
+        int ret = pthread_create(&tid, NULL, schedule_thread, NULL);
+        if (ret != 0)
+            errx(1, "pthread_create: %s", strerror(ret));
+    }
+
     if (utilization_ratio < 0 || utilization_ratio > 100)
         errx(1, "%s", "utilization ratio is not in the interval [0,100]!");
 
-    idle_thread = utilization_ratio == 0 ? 1 : 0;
+    // Assign duty cycle controllers to CPUs. Later profiles take
+    // precedence.
+    struct pwm *pwms[33];
+    int n_pwms = 0;
+    if (n_profiles == 0 && (utilization_ratio == 0 || (period_ms > 0 && utilization_ratio < 100)))
+        pwms[n_pwms++] = pwm_constant(utilization_ratio, (period_ms ?: 100) * MS_TO_NANO, cpus);
+    for (int i = 0; i < n_profiles; i++) {
+        char *colon = strrchr(profiles[i], ':');
+        cpu_set_t *m = colon ? cpulist_parse_compat(colon + 1, "-P cpu_list") : cpulist_alloc();
+        if (colon)
+            *colon = '\0';
+        else
+            CPU_OR_S(setsize, m, m, cpus);
+        CPU_AND_S(setsize, m, m, cpus);
+        pwms[n_pwms++] = pwm_load(profiles[i], (period_ms ?: 100) * MS_TO_NANO, m);
+        CPU_FREE(m);
+    }
+    cpu_pwm = calloc(cpulist_max_cpus(), sizeof(*cpu_pwm));
+    if (!cpu_pwm)
+        err(1, "calloc");
+    for (int p = 0; p < n_pwms; p++) {
+        for (int q = 0; q < p; q++) {
+            cpu_set_t *common = cpulist_alloc();
+            CPU_AND_S(setsize, common, pwms[q]->cpus, pwms[p]->cpus);
+            CPU_XOR_S(setsize, pwms[q]->cpus, pwms[q]->cpus, common);
+            CPU_FREE(common);
+        }
+        for (int i = 0; i < cpulist_max_cpus(); i++)
+            if (CPU_ISSET_S(i, setsize, pwms[p]->cpus))
+                cpu_pwm[i] = pwms[p];
+    }
 
 #ifdef WITH_DEMOS
     if (demos_init() == 0) {
@@ -136,18 +341,23 @@ int main(int argc, char *argv[])
     }
 #endif
 
-    for (int i = 0; i < num_proc; i++) {
+    if (posix_memalign((void **)&counters, 64, cpulist_max_cpus() * sizeof(*counters)) != 0)
+        err(1, "posix_memalign");
+    memset(counters, 0, cpulist_max_cpus() * sizeof(*counters));
+    running = cpulist_alloc();
+
+    cpu_set_t *cpuset = cpulist_alloc();
+    for (int i = 0; i < cpulist_max_cpus(); i++) {
         pthread_attr_t attr;
-        cpu_set_t cpuset;
         pthread_t tid;
 
-        if ((cpu_mask & (1U << i)) == 0)
+        if (!CPU_ISSET_S(i, setsize, cpus))
             continue;
 
-        CPU_ZERO(&cpuset);
-        CPU_SET(i, &cpuset);
+        CPU_ZERO_S(setsize, cpuset);
+        CPU_SET_S(i, setsize, cpuset);
         pthread_attr_init(&attr);
-        pthread_attr_setaffinity_np(&attr, sizeof(cpuset), &cpuset);
+        pthread_attr_setaffinity_np(&attr, setsize, cpuset);
         int ret = pthread_create(&tid, &attr, benchmark_loop, (void *)(intptr_t)i);
         if (ret != 0) {
             warnx("Warning: CPU %d thread creation error: %s", i, strerror(ret));
@@ -156,33 +366,19 @@ int main(int argc, char *argv[])
             // this is the first successfully spawned thread
             first_thread_id = i;
         }
+        if (ret == 0)
+            CPU_SET_S(i, setsize, running);
     }
 
-    if (period_ms > 0) {
-        if (utilization_ratio > 0 && utilization_ratio < 100) {
-            struct timespec next;
-
-            clock_gettime(CLOCK_MONOTONIC, &next);
-
-            while (1) {
-                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
-
-                pthread_mutex_lock(&mutex);
-                idle_thread = 0; /* start thread */
-                pthread_cond_broadcast(&cond); /* Wake-up all waiting threads */
-                pthread_mutex_unlock(&mutex);
-
-                timespec_add_ms(&next, period_ms * utilization_ratio / 100);
-                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
-
-                pthread_mutex_lock(&mutex);
-                idle_thread = 1; /* stop thread */
-                pthread_mutex_unlock(&mutex);
-
-                timespec_add_ms(&next, period_ms * (100 - utilization_ratio) / 100);
-            }
-        }
+    if (report_interval_ms) {
+        pthread_t tid;
+        int ret = pthread_create(&tid, NULL, reporter_thread, NULL);
+        if (ret != 0)
+            errx(1, "pthread_create: %s", strerror(ret));
     }
 
+    for (int p = 0; p < n_pwms; p++)
+        pwm_start(pwms[p]);
+
     pthread_exit(NULL);
 }
@@ -0,0 +1,205 @@
+#define _GNU_SOURCE
+#include "pwm.h"
+#include "cpulist.h"
+#include <err.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SEC_TO_NANO 1000000000
+
+static struct pwm *pwm_alloc(long period_ns, const cpu_set_t *cpus)
+{
+    struct pwm *pwm;
+
+    if (posix_memalign((void **)&pwm, 64, sizeof(*pwm)) != 0)
+        err(1, "posix_memalign");
+    memset(pwm, 0, sizeof(*pwm));
+    pwm->period_ns = period_ns;
+    pwm->cpus = cpulist_alloc();
+    CPU_OR_S(cpulist_setsize(), pwm->cpus, pwm->cpus, cpus);
+    return pwm;
+}
+
+static void pwm_add_segment(struct pwm *pwm, struct pwm_segment seg)
+{
+    pwm->segments = realloc(pwm->segments, (pwm->n_segments + 1) * sizeof(*pwm->segments));
+    if (!pwm->segments)
+        err(1, "realloc");
+    pwm->segments[pwm->n_segments++] = seg;
+    pwm->total += seg.duration;
+}
+
+struct pwm *pwm_constant(double utilization, long period_ns, const cpu_set_t *cpus)
+{
+    struct pwm *pwm = pwm_alloc(period_ns, cpus);
+
+    pwm_add_segment(pwm, (struct pwm_segment){ .duration = 1, .shape = PWM_CONST, .a = utilization });
+    pwm->duty.idle = utilization == 0;
+    return pwm;
+}
+
+/*
+ * Load utilization profile from a file. Every line specifies a
+ * segment of the profile:
+ *
+ *     DURATION const U             constant utilization U [%]
+ *     DURATION ramp U1 U2          linear change from U1 to U2
+ *     DURATION square PERIOD [HIGH [LOW]]
+ *                                  square wave with PERIOD [s] alternating
+ *                                  between HIGH (default 100) and LOW (0)
+ *     DURATION prbs BIT [HIGH [LOW]]
+ *                                  pseudo-random binary sequence (PRBS7)
+ *                                  with bit duration BIT [s]
+ *
+ * DURATION is in seconds. Empty lines and lines starting with '#' are
+ * ignored. The profile repeats after the last segment.
+ */
+struct pwm *pwm_load(const char *file, long period_ns, const cpu_set_t *cpus)
+{
+    struct pwm *pwm = pwm_alloc(period_ns, cpus);
+    FILE *fp = fopen(file, "r");
+    char *line = NULL;
+    size_t len = 0;
+    int lineno = 0;
+
+    if (!fp)
+        err(1, "%s", file);
+
+    while (getline(&line, &len, fp) != -1) {
+        struct pwm_segment seg = { .b = 100, .c = 0 };
+        char shape[16];
+        int n;
+
+        lineno++;
+        if (sscanf(line, " %n", &n) == 0 && (line[n] == '\0' || line[n] == '#'))
+            continue;
+        n = sscanf(line, "%lf %15s %lf %lf %lf", &seg.duration, shape, &seg.a, &seg.b, &seg.c);
+        if (n < 3 || seg.duration <= 0)
+            errx(1, "%s:%d: Invalid profile segment", file, lineno);
+
+        if (strcmp(shape, "const") == 0 && n == 3) {
+            seg.shape = PWM_CONST;
+        } else if (strcmp(shape, "ramp") == 0 && n == 4) {
+            seg.shape = PWM_RAMP;
+        } else if (strcmp(shape, "square") == 0 && seg.a > 0) {
+            seg.shape = PWM_SQUARE;
+        } else if (strcmp(shape, "prbs") == 0 && seg.a > 0) {
+            seg.shape = PWM_PRBS;
+        } else {
+            errx(1, "%s:%d: Invalid profile segment", file, lineno);
+        }
+        pwm_add_segment(pwm, seg);
+    }
+    free(line);
+    fclose(fp);
+
+    if (pwm->n_segments == 0)
+        errx(1, "%s: Empty profile", file);
+    pwm->report = true;
+    pwm->duty.idle = pwm_utilization(pwm, 0) == 0;
+    return pwm;
+}
+
+// Value of PRBS7 (x^7 + x^6 + 1) sequence at position k
+static bool prbs7(unsigned long k)
+{
+    uint8_t lfsr = 0x7f;
+    bool bit = 1;
+
+    for (k = k % 127 + 1; k; k--) {
+        bit = ((lfsr >> 6) ^ (lfsr >> 5)) & 1;
+        lfsr = ((lfsr << 1) | bit) & 0x7f;
+    }
+    return bit;
+}
+
+// Utilization [%] at time t [s] since the start of the profile
+double pwm_utilization(const struct pwm *pwm, double t)
+{
+    const struct pwm_segment *s = pwm->segments;
+
+    t = fmod(t, pwm->total);
+    while (t >= s->duration && s < pwm->segments + pwm->n_segments - 1)
+        t -= (s++)->duration;
+
+    switch (s->shape) {
+    case PWM_CONST:
+        return s->a;
+    case PWM_RAMP:
+        return s->a + (s->b - s->a) * t / s->duration;
+    case PWM_SQUARE:
+        return fmod(t, s->a) < s->a / 2 ? s->b : s->c;
+    case PWM_PRBS:
+        return prbs7(t / s->a) ? s->b : s->c;
+    }
+    return 100;
+}
+
+static void timespec_add_ns(struct timespec *ts, long long ns)
+{
+    ts->tv_sec += (ts->tv_nsec + ns) / SEC_TO_NANO;
+    ts->tv_nsec = (ts->tv_nsec + ns) % SEC_TO_NANO;
+}
+
+void pwm_park(struct pwm *pwm)
+{
+    while (__atomic_load_n(&pwm->duty.idle, __ATOMIC_RELAXED))
+        syscall(SYS_futex, &pwm->duty.idle, FUTEX_WAIT_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static void *pwm_thread(void *ptr)
+{
+    struct pwm *pwm = ptr;
+    struct timespec start, next;
+    double reported_u = NAN, reported_t = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    next = start;
+
+    while (1) {
+        double t = (next.tv_sec - start.tv_sec) + (next.tv_nsec - start.tv_nsec) / 1e9;
+        double u = fmin(fmax(pwm_utilization(pwm, t), 0), 100);
+        long run_ns = pwm->period_ns * u / 100;
+
+        // Report changes only, so that thermobench parsing the output
+        // does not load the CPUs. Gradual changes (ramps) are reported
+        // in 1% steps or once per second.
+        if (pwm->report && u != reported_u && !(fabs(u - reported_u) < 1 && t - reported_t < 1)) {
+            reported_u = u;
+            reported_t = t;
+            for (int i = 0; i < cpulist_max_cpus(); i++)
+                if (CPU_ISSET_S(i, cpulist_setsize(), pwm->cpus))
+                    printf("CPU%d_utilization=%g\n", i, u);
+            fflush(stdout);
+        }
+
+        if (run_ns > 0) {
+            __atomic_store_n(&pwm->duty.idle, 0, __ATOMIC_RELAXED); /* start threads */
+            syscall(SYS_futex, &pwm->duty.idle, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+            timespec_add_ns(&next, run_ns);
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        }
+        if (run_ns < pwm->period_ns) {
+            __atomic_store_n(&pwm->duty.idle, 1, __ATOMIC_RELAXED); /* stop threads */
+            timespec_add_ns(&next, pwm->period_ns - run_ns);
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        }
+    }
+    return NULL;
+}
+
+void pwm_start(struct pwm *pwm)
+{
+    pthread_t tid;
+    int ret = pthread_create(&tid, NULL, pwm_thread, pwm);
+    if (ret != 0)
+        errx(1, "pthread_create: %s", strerror(ret));
+}
@@ -0,0 +1,56 @@
+#ifndef PWM_H
+#define PWM_H
+
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Part of a utilization profile
+struct pwm_segment {
+    double duration; // s
+    enum { PWM_CONST, PWM_RAMP, PWM_SQUARE, PWM_PRBS } shape;
+    double a, b, c; // Shape parameters, see pwm_load()
+};
+
+// Duty cycle control of benchmark threads. The controller thread
+// (pwm_start) periodically lets the threads run for the utilization
+// given by the profile and then parks them.
+struct pwm {
+    struct pwm_segment *segments;
+    int n_segments;
+    double total; // Duration of the profile [s]
+    long period_ns; // PWM period
+    cpu_set_t *cpus; // CPUs controlled by this profile (see cpulist.h)
+    bool report; // Print CPU<n>_utilization=U lines when U changes
+
+    // The flag has its own cache line, which stays shared in all
+    // cores' caches while it does not change, so the check in the
+    // benchmark loop (once per bench_func() call) is a plain L1 load,
+    // which is much cheaper than locking a mutex. In the idle phase,
+    // threads sleep in futex_wait().
+    //
+    // Measured overhead: work_done rate of `instr -k alu_int64_add`
+    // without PWM vs. with `-P` profile "1 const 100" and `-p 100`,
+    // 8 alternating 7 s runs each on a 1-CPU x86_64 VM. The medians
+    // were 5.84 vs. 5.72 Gops/s (2%, i.e. at most about 3.5 ns per
+    // bench_func() call of 175 ns), which is within the run-to-run
+    // spread of ±8%.
+    struct {
+        uint32_t idle; /* futex word: 1 = idle phase, 0 = run phase */
+    } __attribute__((aligned(64))) duty;
+};
+
+struct pwm *pwm_constant(double utilization, long period_ns, const cpu_set_t *cpus);
+struct pwm *pwm_load(const char *file, long period_ns, const cpu_set_t *cpus);
+double pwm_utilization(const struct pwm *pwm, double t);
+void pwm_start(struct pwm *pwm);
+void pwm_park(struct pwm *pwm);
+
+// Called by benchmark threads before every bench_func() call
+static inline void pwm_check(struct pwm *pwm)
+{
+    if (__atomic_load_n(&pwm->duty.idle, __ATOMIC_RELAXED))
+        pwm_park(pwm);
+}
+
+#endif
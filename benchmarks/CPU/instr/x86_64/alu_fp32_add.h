@@ -0,0 +1,7 @@
+#include "x86.h"
+
+#define bench_t float
+#define INSN(c) OP2("addss", c)
+
+// 1024 scalar SSE addss instructions
+BENCH_KERNEL(INSN, "x", 1e-3f, 1.0f, 1)
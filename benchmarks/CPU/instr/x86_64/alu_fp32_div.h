@@ -0,0 +1,7 @@
+#include "x86.h"
+
+#define bench_t float
+#define INSN(c) OP2("divss", c)
+
+// 1024 scalar SSE divss instructions
+BENCH_KERNEL(INSN, "x", 1.0000001f, 1.0f, 1)
@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "fma"
+#define bench_t float
+#define INSN(c) FMA3("vfmadd231ss", c)
+
+// 1024 scalar FMA vfmadd231ss instructions
+BENCH_KERNEL(INSN, "x", 1e-3f, 1.0f, 1)
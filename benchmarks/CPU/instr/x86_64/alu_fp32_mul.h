@@ -0,0 +1,7 @@
+#include "x86.h"
+
+#define bench_t float
+#define INSN(c) OP2("mulss", c)
+
+// 1024 scalar SSE mulss instructions
+BENCH_KERNEL(INSN, "x", 0.9999999f, 1.0f, 1)
@@ -0,0 +1,7 @@
+#include "x86.h"
+
+#define bench_t double
+#define INSN(c) OP2("addsd", c)
+
+// 1024 scalar SSE addsd instructions
+BENCH_KERNEL(INSN, "x", 1e-3, 1.0, 1)
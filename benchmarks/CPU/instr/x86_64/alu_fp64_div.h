@@ -0,0 +1,7 @@
+#include "x86.h"
+
+#define bench_t double
+#define INSN(c) OP2("divsd", c)
+
+// 1024 scalar SSE divsd instructions
+BENCH_KERNEL(INSN, "x", 1.0000001, 1.0, 1)
@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "fma"
+#define bench_t double
+#define INSN(c) FMA3("vfmadd231sd", c)
+
+// 1024 scalar FMA vfmadd231sd instructions
+BENCH_KERNEL(INSN, "x", 1e-3, 1.0, 1)
@@ -0,0 +1,7 @@
+#include "x86.h"
+
+#define bench_t double
+#define INSN(c) OP2("mulsd", c)
+
+// 1024 scalar SSE mulsd instructions
+BENCH_KERNEL(INSN, "x", 0.9999999, 1.0, 1)
@@ -0,0 +1,37 @@
+#include "x86.h"
+
+#define bench_t int64_t
+
+// 256 scalar idiv instructions. Division uses fixed registers
+// (rdx:rax), so the chains cannot be interleaved as in BENCH_KERNEL.
+// In the throughput variant, every division starts from a fresh
+// dividend, so the divisions are independent and limited only by the
+// divider. In the latency variant (BENCH_CHAINS == 1), the quotient
+// in rax is the dividend of the next division. The divisor is 1 there
+// so that the quotient stays the same large number; a shrinking
+// quotient would make the division faster on CPUs whose divider
+// finishes early for small quotients.
+int bench_func()
+{
+    bench_t n = 1000000000000000003;
+#if BENCH_CHAINS == 1
+    bench_t d = 1;
+
+    asm volatile("mov %[n], %%rax\n\t" REPEAT256("cqto\n\t"
+                                                 "idiv %[d]\n\t")
+                 :
+                 : [ n ] "r"(n), [ d ] "r"(d)
+                 : "rax", "rdx");
+#else
+    bench_t d = 7;
+
+    asm volatile(REPEAT256("mov %[n], %%rax\n\t"
+                           "cqto\n\t"
+                           "idiv %[d]\n\t")
+                 :
+                 : [ n ] "r"(n), [ d ] "r"(d)
+                 : "rax", "rdx");
+#endif
+
+    return 256; // return the number of divisions executed
+}
@@ -0,0 +1,7 @@
+#include "x86.h"
+
+#define bench_t int64_t
+#define INSN(c) OP2("imul", c)
+
+// 1024 scalar imul instructions
+BENCH_KERNEL(INSN, "r", 3, 1, 1)
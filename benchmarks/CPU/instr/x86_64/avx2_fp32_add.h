@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "avx"
+#define bench_t __m256
+#define INSN(c) OP3("vaddps", c)
+
+// 1024 AVX2 vaddps instructions (8 × fp32)
+BENCH_KERNEL(INSN, "x", _mm256_set1_ps(1e-3f), _mm256_set1_ps(1.0f), 8)
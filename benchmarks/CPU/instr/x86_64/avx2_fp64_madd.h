@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "fma"
+#define bench_t __m256d
+#define INSN(c) FMA3("vfmadd231pd", c)
+
+// 1024 AVX2 vfmadd231pd instructions (4 × fp64)
+BENCH_KERNEL(INSN, "x", _mm256_set1_pd(1e-3), _mm256_set1_pd(1.0), 4)
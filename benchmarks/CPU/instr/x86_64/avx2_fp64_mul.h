@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "avx"
+#define bench_t __m256d
+#define INSN(c) OP3("vmulpd", c)
+
+// 1024 AVX2 vmulpd instructions (4 × fp64)
+BENCH_KERNEL(INSN, "x", _mm256_set1_pd(0.9999999), _mm256_set1_pd(1.0), 4)
@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "avx2"
+#define bench_t __m256i
+#define INSN(c) OP3("vpaddw", c)
+
+// 1024 AVX2 vpaddw instructions (16 × int16)
+BENCH_KERNEL(INSN, "x", _mm256_set1_epi16(1), _mm256_set1_epi16(0), 16)
@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "avx2"
+#define bench_t __m256i
+#define INSN(c) OP3("vpmullw", c)
+
+// 1024 AVX2 vpmullw instructions (16 × int16)
+BENCH_KERNEL(INSN, "x", _mm256_set1_epi16(3), _mm256_set1_epi16(1), 16)
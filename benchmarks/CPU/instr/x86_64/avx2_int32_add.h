@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "avx2"
+#define bench_t __m256i
+#define INSN(c) OP3("vpaddd", c)
+
+// 1024 AVX2 vpaddd instructions (8 × int32)
+BENCH_KERNEL(INSN, "x", _mm256_set1_epi32(1), _mm256_set1_epi32(0), 8)
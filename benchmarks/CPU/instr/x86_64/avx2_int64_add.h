@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "avx2"
+#define bench_t __m256i
+#define INSN(c) OP3("vpaddq", c)
+
+// 1024 AVX2 vpaddq instructions (4 × int64)
+BENCH_KERNEL(INSN, "x", _mm256_set1_epi64x(1), _mm256_set1_epi64x(0), 4)
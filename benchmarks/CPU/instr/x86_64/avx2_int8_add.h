@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "avx2"
+#define bench_t __m256i
+#define INSN(c) OP3("vpaddb", c)
+
+// 1024 AVX2 vpaddb instructions (32 × int8)
+BENCH_KERNEL(INSN, "x", _mm256_set1_epi8(1), _mm256_set1_epi8(0), 32)
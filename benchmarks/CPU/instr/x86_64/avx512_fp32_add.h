@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "avx512f"
+#define bench_t __m512
+#define INSN(c) OP3("vaddps", c)
+
+// 1024 AVX-512 vaddps instructions (16 × fp32)
+BENCH_KERNEL(INSN, "v", _mm512_set1_ps(1e-3f), _mm512_set1_ps(1.0f), 16)
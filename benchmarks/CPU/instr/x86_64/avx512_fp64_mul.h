@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "avx512f"
+#define bench_t __m512d
+#define INSN(c) OP3("vmulpd", c)
+
+// 1024 AVX-512 vmulpd instructions (8 × fp64)
+BENCH_KERNEL(INSN, "v", _mm512_set1_pd(0.9999999), _mm512_set1_pd(1.0), 8)
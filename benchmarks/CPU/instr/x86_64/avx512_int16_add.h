@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "avx512bw"
+#define bench_t __m512i
+#define INSN(c) OP3("vpaddw", c)
+
+// 1024 AVX-512 vpaddw instructions (32 × int16)
+BENCH_KERNEL(INSN, "v", _mm512_set1_epi16(1), _mm512_set1_epi16(0), 32)
@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "avx512f"
+#define bench_t __m512i
+#define INSN(c) OP3("vpaddd", c)
+
+// 1024 AVX-512 vpaddd instructions (16 × int32)
+BENCH_KERNEL(INSN, "v", _mm512_set1_epi32(1), _mm512_set1_epi32(0), 16)
@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "avx512f"
+#define bench_t __m512i
+#define INSN(c) OP3("vpaddq", c)
+
+// 1024 AVX-512 vpaddq instructions (8 × int64)
+BENCH_KERNEL(INSN, "v", _mm512_set1_epi64(1), _mm512_set1_epi64(0), 8)
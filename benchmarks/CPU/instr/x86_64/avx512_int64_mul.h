@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "avx512dq"
+#define bench_t __m512i
+#define INSN(c) OP3("vpmullq", c)
+
+// 1024 AVX-512 vpmullq instructions (8 × int64)
+BENCH_KERNEL(INSN, "v", _mm512_set1_epi64(3), _mm512_set1_epi64(1), 8)
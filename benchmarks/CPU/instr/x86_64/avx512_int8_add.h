@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "avx512bw"
+#define bench_t __m512i
+#define INSN(c) OP3("vpaddb", c)
+
+// 1024 AVX-512 vpaddb instructions (64 × int8)
+BENCH_KERNEL(INSN, "v", _mm512_set1_epi8(1), _mm512_set1_epi8(0), 64)
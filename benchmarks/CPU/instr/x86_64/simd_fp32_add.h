@@ -0,0 +1,7 @@
+#include "x86.h"
+
+#define bench_t __m128
+#define INSN(c) OP2("addps", c)
+
+// 1024 SSE addps instructions (4 × fp32)
+BENCH_KERNEL(INSN, "x", _mm_set1_ps(1e-3f), _mm_set1_ps(1.0f), 4)
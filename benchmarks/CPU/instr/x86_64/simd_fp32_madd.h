@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "fma"
+#define bench_t __m128
+#define INSN(c) FMA3("vfmadd231ps", c)
+
+// 1024 SSE vfmadd231ps instructions (4 × fp32)
+BENCH_KERNEL(INSN, "x", _mm_set1_ps(1e-3f), _mm_set1_ps(1.0f), 4)
@@ -0,0 +1,7 @@
+#include "x86.h"
+
+#define bench_t __m128d
+#define INSN(c) OP2("addpd", c)
+
+// 1024 SSE addpd instructions (2 × fp64)
+BENCH_KERNEL(INSN, "x", _mm_set1_pd(1e-3), _mm_set1_pd(1.0), 2)
@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "fma"
+#define bench_t __m128d
+#define INSN(c) FMA3("vfmadd231pd", c)
+
+// 1024 SSE vfmadd231pd instructions (2 × fp64)
+BENCH_KERNEL(INSN, "x", _mm_set1_pd(1e-3), _mm_set1_pd(1.0), 2)
@@ -0,0 +1,7 @@
+#include "x86.h"
+
+#define bench_t __m128i
+#define INSN(c) OP2("paddw", c)
+
+// 1024 SSE paddw instructions (8 × int16)
+BENCH_KERNEL(INSN, "x", _mm_set1_epi16(1), _mm_set1_epi16(0), 8)
@@ -0,0 +1,7 @@
+#include "x86.h"
+
+#define bench_t __m128i
+#define INSN(c) OP2("pmullw", c)
+
+// 1024 SSE pmullw instructions (8 × int16)
+BENCH_KERNEL(INSN, "x", _mm_set1_epi16(3), _mm_set1_epi16(1), 8)
@@ -0,0 +1,7 @@
+#include "x86.h"
+
+#define bench_t __m128i
+#define INSN(c) OP2("paddd", c)
+
+// 1024 SSE paddd instructions (4 × int32)
+BENCH_KERNEL(INSN, "x", _mm_set1_epi32(1), _mm_set1_epi32(0), 4)
@@ -0,0 +1,8 @@
+#include "x86.h"
+
+#define BENCH_ISA "sse4.1"
+#define bench_t __m128i
+#define INSN(c) OP2("pmulld", c)
+
+// 1024 SSE pmulld instructions (4 × int32)
+BENCH_KERNEL(INSN, "x", _mm_set1_epi32(3), _mm_set1_epi32(1), 4)
@@ -0,0 +1,7 @@
+#include "x86.h"
+
+#define bench_t __m128i
+#define INSN(c) OP2("paddq", c)
+
+// 1024 SSE paddq instructions (2 × int64)
+BENCH_KERNEL(INSN, "x", _mm_set1_epi64x(1), _mm_set1_epi64x(0), 2)
@@ -0,0 +1,7 @@
+#include "x86.h"
+
+#define bench_t __m128i
+#define INSN(c) OP2("paddb", c)
+
+// 1024 SSE paddb instructions (16 × int8)
+BENCH_KERNEL(INSN, "x", _mm_set1_epi8(1), _mm_set1_epi8(0), 16)
@@ -0,0 +1,48 @@
+#include "../bench.h"
+#include <immintrin.h>
+#include <stdint.h>
+
+#define REPEAT128(x) REPEAT64(x) REPEAT64(x)
+
+// Number of independent dependency chains. The default (8) is enough
+// to saturate the execution units (throughput variant). With 1 every
+// instruction depends on the previous one (latency variant, built as
+// *_lat).
+#ifndef BENCH_CHAINS
+#define BENCH_CHAINS 8
+#endif
+
+#if BENCH_CHAINS == 1
+#define CHAINS(insn) REPEAT1024(insn("c0"))
+#elif BENCH_CHAINS == 8
+#define CHAINS(insn) REPEAT128(insn("c0") insn("c1") insn("c2") insn("c3") insn("c4") insn("c5") insn("c6") insn("c7"))
+#else
+#error BENCH_CHAINS must be 1 or 8
+#endif
+
+// Define bench_func() executing 1024 instructions INSN(c), where c is
+// the name of the accumulator operand. INSN can also use operands a
+// and b. CONS is the asm constraint for the operands of type bench_t
+// and OPS is the number of operations per instruction (vector
+// lanes).
+#define BENCH_KERNEL(INSN, CONS, a_init, c_init, OPS)                                                                  \
+    int bench_func()                                                                                                   \
+    {                                                                                                                  \
+        bench_t a = a_init, b = a_init;                                                                                \
+        bench_t c0 = c_init, c1 = c_init, c2 = c_init, c3 = c_init;                                                    \
+        bench_t c4 = c_init, c5 = c_init, c6 = c_init, c7 = c_init;                                                    \
+                                                                                                                       \
+        asm volatile(CHAINS(INSN)                                                                                      \
+                     : [ c0 ] "+" CONS(c0), [ c1 ] "+" CONS(c1), [ c2 ] "+" CONS(c2), [ c3 ] "+" CONS(c3),             \
+                       [ c4 ] "+" CONS(c4), [ c5 ] "+" CONS(c5), [ c6 ] "+" CONS(c6), [ c7 ] "+" CONS(c7)              \
+                     : [ a ] CONS(a), [ b ] CONS(b)                                                                    \
+                     :);                                                                                               \
+                                                                                                                       \
+        return 1024 * (OPS); /* return the number of operations executed */                                          \
+    }
+
+// Instruction templates for INSN: c = c OP a in 2-operand (legacy SSE,
+// scalar integer) and 3-operand (VEX, EVEX) form and c = a * b + c (FMA)
+#define OP2(op, c) op " %[a], %[" c "]\n\t"
+#define OP3(op, c) op " %[a], %[" c "], %[" c "]\n\t"
+#define FMA3(op, c) op " %[a], %[b], %[" c "]\n\t"
@@ -0,0 +1,160 @@
+#define _GNU_SOURCE
+#include "cpulist.h"
+#include <ctype.h>
+#include <err.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int cpulist_max_cpus(void)
+{
+    static int max_cpus;
+
+    if (max_cpus)
+        return max_cpus;
+
+    // sched_getaffinity() fails with EINVAL when the set is smaller
+    // than the kernel's CPU mask, which can be bigger than the number
+    // of configured CPUs (e.g. with CPU hotplug).
+    int n = sysconf(_SC_NPROCESSORS_CONF);
+    if (n < 1)
+        n = 1;
+    while (1) {
+        cpu_set_t *set = CPU_ALLOC(n);
+        if (!set)
+            err(1, "CPU_ALLOC");
+        int ret = sched_getaffinity(0, CPU_ALLOC_SIZE(n), set);
+        CPU_FREE(set);
+        if (ret == 0 || errno != EINVAL)
+            break;
+        n *= 2;
+    }
+    max_cpus = CPU_ALLOC_SIZE(n) * 8;
+    return max_cpus;
+}
+
+size_t cpulist_setsize(void)
+{
+    return CPU_ALLOC_SIZE(cpulist_max_cpus());
+}
+
+cpu_set_t *cpulist_alloc(void)
+{
+    cpu_set_t *set = CPU_ALLOC(cpulist_max_cpus());
+    if (!set)
+        err(1, "CPU_ALLOC");
+    CPU_ZERO_S(cpulist_setsize(), set);
+    return set;
+}
+
+cpu_set_t *cpulist_affinity(void)
+{
+    cpu_set_t *set = cpulist_alloc();
+    if (sched_getaffinity(0, cpulist_setsize(), set) == -1)
+        err(1, "sched_getaffinity");
+    return set;
+}
+
+static void set_cpu(cpu_set_t *set, long cpu, const char *str, const char *err_msg)
+{
+    if (cpu >= cpulist_max_cpus())
+        errx(1, "%s: CPU %ld does not exist (max. %d): %s", err_msg, cpu, cpulist_max_cpus() - 1, str);
+    CPU_SET_S(cpu, cpulist_setsize(), set);
+}
+
+static cpu_set_t *parse_mask(const char *str, const char *err_msg)
+{
+    cpu_set_t *set = cpulist_alloc();
+    const char *digits = str + 2;
+    size_t len = strlen(digits);
+
+    if (len == 0)
+        errx(1, "%s: No digits were found: %s", err_msg, str);
+    for (size_t i = 0; i < len; i++) {
+        char c = digits[len - 1 - i];
+        if (!isxdigit((unsigned char)c))
+            errx(1, "%s: Invalid character '%c' in CPU mask: %s", err_msg, c, str);
+        int v = isdigit((unsigned char)c) ? c - '0' : tolower((unsigned char)c) - 'a' + 10;
+        for (int b = 0; b < 4; b++)
+            if (v & (1 << b))
+                set_cpu(set, 4 * i + b, str, err_msg);
+    }
+    return set;
+}
+
+static long parse_cpu(const char **p, const char *str, const char *err_msg)
+{
+    char *end;
+
+    if (!isdigit((unsigned char)**p))
+        errx(1, "%s: Invalid CPU list: %s", err_msg, str);
+    errno = 0;
+    long cpu = strtol(*p, &end, 10);
+    if (errno != 0)
+        err(1, "%s", err_msg);
+    *p = end;
+    return cpu;
+}
+
+cpu_set_t *cpulist_parse(const char *str, const char *err_msg)
+{
+    if (strncmp(str, "0x", 2) == 0 || strncmp(str, "0X", 2) == 0)
+        return parse_mask(str, err_msg);
+
+    cpu_set_t *set = cpulist_alloc();
+    const char *p = str;
+
+    do {
+        long first = parse_cpu(&p, str, err_msg), last = first;
+        if (*p == '-') {
+            p++;
+            last = parse_cpu(&p, str, err_msg);
+            if (last < first)
+                errx(1, "%s: Invalid CPU range %ld-%ld: %s", err_msg, first, last, str);
+        }
+        for (long cpu = first; cpu <= last; cpu++)
+            set_cpu(set, cpu, str, err_msg);
+    } while (*p++ == ',');
+
+    if (*--p != '\0')
+        errx(1, "%s: Further characters after CPU list: %s", err_msg, p);
+    return set;
+}
+
+cpu_set_t *cpulist_parse_compat(const char *str, const char *err_msg)
+{
+    if (*str && strspn(str, "0123456789") == strlen(str) && strtol(str, NULL, 10) != 0)
+        errx(1,
+             "%s: Ambiguous argument %s: CPUs are given as a list, not as a decimal mask. "
+             "Use 0x%lx for the mask or %s-%s for the single CPU",
+             err_msg, str, strtol(str, NULL, 10), str, str);
+    return cpulist_parse(str, err_msg);
+}
+
+char *cpulist_format(const cpu_set_t *set)
+{
+    size_t size = 0;
+    char *str = NULL;
+    FILE *f = open_memstream(&str, &size);
+    const char *sep = "";
+
+    if (!f)
+        err(1, "open_memstream");
+    for (int i = 0; i < cpulist_max_cpus(); i++) {
+        if (!CPU_ISSET_S(i, cpulist_setsize(), set))
+            continue;
+        int j = i;
+        while (j + 1 < cpulist_max_cpus() && CPU_ISSET_S(j + 1, cpulist_setsize(), set))
+            j++;
+        if (j == i)
+            fprintf(f, "%s%d", sep, i);
+        else
+            fprintf(f, "%s%d-%d", sep, i, j);
+        sep = ",";
+        i = j;
+    }
+    fclose(f);
+    return str;
+}
@@ -0,0 +1,43 @@
+#ifndef CPULIST_H
+#define CPULIST_H
+
+#include <sched.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// All CPU sets handled by these functions are dynamically allocated
+// (CPU_ALLOC) for cpulist_max_cpus() CPUs, so they are not limited by
+// the size of an integer mask nor by CPU_SETSIZE. Use them with the
+// _S variants of CPU_* macros and cpulist_setsize().
+
+// Number of CPU IDs supported by the kernel (highest possible CPU + 1)
+int cpulist_max_cpus(void);
+// Size of CPU sets in bytes
+size_t cpulist_setsize(void);
+// Allocate an empty CPU set
+cpu_set_t *cpulist_alloc(void);
+// Allocate a CPU set with the affinity of the calling thread
+cpu_set_t *cpulist_affinity(void);
+
+// Parse a CPU list such as "0-63,96-127" (the format of
+// /sys/devices/system/cpu/online and taskset -c) or a hexadecimal
+// mask starting with 0x. Exit with an error message prefixed by
+// err_msg if str is invalid.
+cpu_set_t *cpulist_parse(const char *str, const char *err_msg);
+
+// Like cpulist_parse(), but reject a plain decimal number other than
+// 0. Options that took a decimal bitmask before CPU lists were
+// supported (e.g. -m3 meaning CPUs 0 and 1) would otherwise silently
+// select a different CPU. A single CPU N can be given as N-N.
+cpu_set_t *cpulist_parse_compat(const char *str, const char *err_msg);
+
+// Format set as a CPU list (malloc()ed string)
+char *cpulist_format(const cpu_set_t *set);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
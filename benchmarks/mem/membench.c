@@ -5,8 +5,13 @@
 /**********************************************/
 
 #define _GNU_SOURCE
+#include "cpulist.h"
 #include <assert.h>
 #include <err.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include <linux/mempolicy.h>
 #include <pthread.h>
 #include <sched.h>
 #include <stdbool.h>
@@ -14,6 +19,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
@@ -30,17 +37,34 @@
 
 #define CACHE_LINE_SIZE 64
 
+struct stream_kernel;
+
 struct cfg {
-	bool sequential;
+	const struct stream_kernel *stream; /* NULL = pointer chasing */
+	enum {
+		ORDER_SEQUENTIAL,
+		ORDER_RANDOM,
+		ORDER_RANDOM_PAGES,	/* random lines within random pages */
+	} order;
+	unsigned chains; /* Number of parallel pointer chains, 0 = single chain without MLP reporting */
 	unsigned size;
 	unsigned num_threads;
 	unsigned read_count;
-	cpu_set_t cpu_set;
+	cpu_set_t *cpu_set; /* NULL = inherited affinity */
 	bool write;
 	unsigned ofs;
 	bool use_cycles; /* instead of ns */
 	unsigned report_bandwidth; /* 0 = disabled, 1 = B/s, 1024 = KiB/s, 1024^2 = MiB/s, ... */
 	bool forever;
+	unsigned report_interval_ms; /* 0 = threads print their progress themselves */
+	enum {
+		PAGES_DEFAULT,	/* system THP policy */
+		PAGES_THP,	/* madvise(MADV_HUGEPAGE) */
+		PAGES_NOTHP,	/* madvise(MADV_NOHUGEPAGE) */
+		PAGES_HUGETLB,	/* MAP_HUGETLB with huge_page_size */
+	} pages;
+	size_t huge_page_size;
+	int node; /* NUMA node of the memory, -1 = local node of each thread */
 };
 
 struct s {
@@ -50,7 +74,12 @@ struct s {
 
 static_assert(sizeof(struct s) == CACHE_LINE_SIZE, "Struct size differs from cacheline size");
 
-#define MAX_CPUS 8
+#define HUGE_PAGE_SIZE (2*1024*1024)
+#define MAX_CHAINS 32
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
 
 #ifdef __aarch64__
 #define MRS32(reg) ({ uint32_t v; asm volatile ("mrs %0," # reg : "=r" (v)); v; })
@@ -91,27 +120,88 @@ static uint64_t get_time(struct cfg *cfg)
 
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
 
-static void prepare(struct s *array, unsigned size, bool sequential)
+/* SplitMix64 pseudo-random number generator */
+static uint64_t rng_next(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+	return z ^ (z >> 31);
+}
+
+/* Random number from [0, bound) (Lemire's multiply-shift reduction) */
+static unsigned rng_below(uint64_t *state, unsigned bound)
 {
-	int i, j;
-	int count = size / sizeof(struct s);
+	return ((rng_next(state) >> 32) * bound) >> 32;
+}
+
+/* Fisher-Yates shuffle */
+static void shuffle(unsigned *a, unsigned n, uint64_t *rng)
+{
+	if (n < 2)
+		return;
+	for (unsigned i = n - 1; i > 0; i--) {
+		unsigned j = rng_below(rng, i + 1);
+		unsigned tmp = a[i]; a[i] = a[j]; a[j] = tmp;
+	}
+}
+
+/* Link all elements of the array to a single cyclic list. All
+ * variants are O(n), so that sweeping many sizes is fast. Every
+ * thread prepares its own array, i.e. in parallel with other
+ * threads. */
+static void prepare(struct s *array, unsigned size, int order, size_t page_size, uint64_t seed)
+{
+	unsigned i, count = size / sizeof(struct s);
         assert(count > 0);
 
-	if (sequential) {
+	switch (order) {
+	case ORDER_SEQUENTIAL:
 		for (i = 0; i < count - 1; i++)
 			array[i].ptr = &array[i+1];
 		array[count - 1].ptr = &array[0];
-	} else {
-		memset(array, 0, size);
-		struct s *p = &array[0];
-		for (i = 0; i < count - 1; i++) {
-			p->ptr = (struct s*)1; /* Mark as occupied to avoid self-loop */
-			for (j = rand() % count;
-			     array[j].ptr != NULL;
-			     j = (j >= count) ? 0 : j+1);
-			p = p->ptr = &array[j];
+		break;
+	case ORDER_RANDOM:
+		/* Sattolo's algorithm: Shuffling the identity
+		 * permutation this way results in a random
+		 * permutation with a single cycle. */
+		for (i = 0; i < count; i++)
+			array[i].ptr = &array[i];
+		for (i = count - 1; i > 0; i--) {
+			unsigned j = rng_below(&seed, i);
+			struct s *tmp = array[i].ptr;
+			array[i].ptr = array[j].ptr;
+			array[j].ptr = tmp;
+		}
+		break;
+	case ORDER_RANDOM_PAGES: {
+		/* Visit pages in random order and all cache lines of
+		 * a page in random order before going to the next
+		 * page. This randomizes cache accesses, but causes
+		 * only one TLB miss per page. */
+		unsigned per_page = page_size / sizeof(struct s);
+		unsigned pages = (count + per_page - 1) / per_page;
+		unsigned *page = CHECKNULL(malloc(pages * sizeof(*page)));
+		unsigned *line = CHECKNULL(malloc(count * sizeof(*line)));
+		unsigned n = 0;
+
+		for (i = 0; i < pages; i++)
+			page[i] = i;
+		shuffle(page, pages, &seed);
+		for (unsigned p = 0; p < pages; p++) {
+			unsigned first = page[p] * per_page;
+			unsigned len = (count - first < per_page) ? count - first : per_page;
+			for (i = 0; i < len; i++)
+				line[n + i] = first + i;
+			shuffle(line + n, len, &seed);
+			n += len;
 		}
-		p->ptr = &array[0];
+		for (i = 0; i < count; i++)
+			array[line[i]].ptr = &array[line[(i + 1) % count]];
+		free(line);
+		free(page);
+		break;
+	}
 	}
 }
 
@@ -195,31 +285,276 @@ static void do_write(struct s *array, unsigned accesses, unsigned ofs)
 	}
 }
 
+/* STREAM kernels (see https://www.cs.virginia.edu/stream/) measuring
+ * sustainable memory bandwidth. They operate on vectors of doubles
+ * (GCC vector extensions), which the compiler translates to SSE, AVX,
+ * AVX-512 or NEON instructions. On x86, the widest instruction set
+ * supported by the CPU is selected at runtime. The _nt variants write
+ * the results with non-temporal (cache bypassing) stores, which avoid
+ * reading the destination into the cache before it is overwritten. */
+typedef double vec_t __attribute__ ((vector_size (64)));
+typedef double vec2_t __attribute__ ((vector_size (16)));
+
+#define STREAM_SCALAR 3.0
+
+#ifdef __x86_64__
+#define STREAM_TARGETS __attribute__ ((target_clones ("avx512f", "avx2", "default")))
+#else
+#define STREAM_TARGETS
+#endif
+
+/* Do not let the compiler replace the copy loop with memcpy() */
+#define STREAM_FUNC STREAM_TARGETS __attribute__ ((optimize ("no-tree-loop-distribute-patterns"))) static void
+
+static inline __attribute__ ((always_inline)) void store_nt(vec_t *p, const vec_t *v)
+{
+	const vec2_t *v2 = (const vec2_t *)v;
+#if defined(__SSE2__)
+	/* 128-bit stores are available in all target clones. This
+	 * does not limit the bandwidth, because write-combining
+	 * buffers merge them into full cache line writes. */
+	for (int i = 0; i < 4; i++)
+		_mm_stream_pd((double *)p + 2 * i, (__m128d)v2[i]);
+#elif defined(__aarch64__)
+	asm volatile ("stnp %q1, %q2, [%0]\n\t"
+		      "stnp %q3, %q4, [%0, #32]"
+		      :: "r" (p), "w" (v2[0]), "w" (v2[1]), "w" (v2[2]), "w" (v2[3]) : "memory");
+#else
+	*p = *v;
+#endif
+}
+
+#define STREAM_KERNEL(name, dst, expr)						\
+	STREAM_FUNC name(vec_t *restrict a, vec_t *restrict b, vec_t *restrict c, size_t n) \
+	{									\
+		for (size_t i = 0; i < n; i++)					\
+			dst[i] = expr;						\
+	}									\
+	STREAM_FUNC name##_nt(vec_t *restrict a, vec_t *restrict b, vec_t *restrict c, size_t n) \
+	{									\
+		for (size_t i = 0; i < n; i++) {				\
+			vec_t v = expr;						\
+			store_nt(&dst[i], &v);					\
+		}								\
+	}
+
+STREAM_KERNEL(stream_copy, c, a[i])
+STREAM_KERNEL(stream_scale, b, STREAM_SCALAR * c[i])
+STREAM_KERNEL(stream_add, c, a[i] + b[i])
+STREAM_KERNEL(stream_triad, a, b[i] + STREAM_SCALAR * c[i])
+
+static const struct stream_kernel {
+	const char *name;
+	void (*func)(vec_t *restrict a, vec_t *restrict b, vec_t *restrict c, size_t n);
+	unsigned arrays; /* Number of accessed arrays */
+} stream_kernels[] = {
+	{ "copy",	stream_copy,		2 },
+	{ "copy_nt",	stream_copy_nt,		2 },
+	{ "scale",	stream_scale,		2 },
+	{ "scale_nt",	stream_scale_nt,	2 },
+	{ "add",	stream_add,		3 },
+	{ "add_nt",	stream_add_nt,		3 },
+	{ "triad",	stream_triad,		3 },
+	{ "triad_nt",	stream_triad_nt,	3 },
+};
+
+/* Memory-level parallelism (MLP): Walk k independent pointer chains
+ * in the same loop, so that up to k cache misses are outstanding at
+ * the same time. The chains are parts of the same cyclic list
+ * starting at different places, so they never meet. The loop is
+ * instantiated for every k to keep all pointers in registers. */
+#define MLP_REPEAT(X) \
+	X(0)  X(1)  X(2)  X(3)  X(4)  X(5)  X(6)  X(7)  X(8)  X(9)  X(10) X(11) X(12) X(13) X(14) X(15) \
+	X(16) X(17) X(18) X(19) X(20) X(21) X(22) X(23) X(24) X(25) X(26) X(27) X(28) X(29) X(30) X(31)
+
+volatile uintptr_t mlp_sink; /* Prevents optimizing the loop away */
+
+static inline __attribute__ ((always_inline))
+void do_read_mlp_k(struct s **start, unsigned iterations, const unsigned k)
+{
+	uintptr_t sink = 0;
+#define MLP_INIT(n) struct s *p##n = start[n < k ? n : 0];
+	MLP_REPEAT(MLP_INIT)
+
+	for (unsigned i = iterations; i; i--) {
+#define MLP_STEP(n) if (n < k) p##n = p##n->ptr;
+		MLP_REPEAT(MLP_STEP)
+	}
+#define MLP_SINK(n) if (n < k) sink ^= (uintptr_t)p##n;
+	MLP_REPEAT(MLP_SINK)
+	mlp_sink = sink;
+}
+
+static void do_read_mlp(struct s **start, unsigned iterations, unsigned k)
+{
+	switch (k) {
+#define MLP_CASE(n) case n + 1: do_read_mlp_k(start, iterations, n + 1); break;
+	MLP_REPEAT(MLP_CASE)
+	default:
+		errx(1, "Unsupported number of chains: %u", k);
+	}
+}
+
 struct benchmark_thread {
 	pthread_t id;
 	unsigned cpu;
+	struct s *array;
+	struct s *chain[MAX_CHAINS]; /* Starts of MLP chains */
+	vec_t *stream[3]; /* Arrays a, b, c of STREAM kernels */
 	double result;
 	struct cfg *cfg;
+	/* Updated by the benchmark thread, printed by reporter_thread.
+	 * Aligned to avoid false sharing between threads. */
+	unsigned work_done __attribute__ ((aligned (CACHE_LINE_SIZE)));
 };
 
 pthread_barrier_t barrier;
 
-struct s array[MAX_CPUS][64*0x100000/sizeof(struct s)] __attribute__ ((aligned (2*1024*1024)));
-
 bool print = true;
 
+static size_t array_len(struct cfg *cfg)
+{
+	size_t align = (cfg->pages == PAGES_HUGETLB) ? cfg->huge_page_size : HUGE_PAGE_SIZE;
+	return (cfg->size + align - 1) / align * align;
+}
+
+/* Allocate memory for the benchmark. This is called by benchmark
+ * threads after setting their affinity so that prepare(), which
+ * touches the memory first, allocates the pages from the local NUMA
+ * node (unless cfg->node says otherwise). The memory is aligned to the
+ * huge page size, which allows the kernel to use transparent huge
+ * pages. */
+static void *alloc_array(struct cfg *cfg)
+{
+	size_t len = array_len(cfg);
+	char *start;
+
+	if (cfg->pages == PAGES_HUGETLB) {
+		int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+			(__builtin_ctzl(cfg->huge_page_size) << MAP_HUGE_SHIFT);
+		start = mmap(NULL, len, PROT_READ | PROT_WRITE, flags, -1, 0);
+		if (start == MAP_FAILED)
+			err(1, "Cannot allocate %zu MiB in %zu KiB huge pages (see /sys/kernel/mm/hugepages)",
+			    len >> 20, cfg->huge_page_size >> 10);
+	} else {
+		char *p = CHECKPTR(mmap(NULL, len + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+		start = (char *)(((uintptr_t)p + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+
+		/* Unmap the unaligned head and the rest of the tail */
+		if (start != p)
+			CHECK(munmap(p, start - p));
+		CHECK(munmap(start + len, p + HUGE_PAGE_SIZE - start));
+
+		if (cfg->pages == PAGES_THP)
+			CHECK(madvise(start, len, MADV_HUGEPAGE));
+		if (cfg->pages == PAGES_NOTHP)
+			CHECK(madvise(start, len, MADV_NOHUGEPAGE));
+	}
+
+	if (cfg->node >= 0) {
+		unsigned long nodemask[cfg->node / (8 * sizeof(unsigned long)) + 1];
+		memset(nodemask, 0, sizeof(nodemask));
+		nodemask[cfg->node / (8 * sizeof(unsigned long))] = 1UL << (cfg->node % (8 * sizeof(unsigned long)));
+		if (syscall(SYS_mbind, start, len, MPOL_BIND, nodemask, 8 * sizeof(nodemask) + 1, 0) == -1)
+			err(1, "mbind to NUMA node %d", cfg->node);
+	}
+	return start;
+}
+
+static void free_array(void *array, struct cfg *cfg)
+{
+	CHECK(munmap(array, array_len(cfg)));
+}
+
+/* Report the page size and NUMA node backing the memory of a thread.
+ * The values are read from /proc/self/smaps for the whole mapping
+ * containing the array, which may be merged with neighbouring
+ * mappings. */
+static void report_memory(struct benchmark_thread *me)
+{
+	FILE *f = fopen("/proc/self/smaps", "r");
+	char line[256];
+	bool found = false;
+	unsigned long page_kb = 0, thp_kb = 0, size_kb = 0;
+	int node = -1;
+
+	if (!f) {
+		warn("/proc/self/smaps");
+		return;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		unsigned long start, end;
+		if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+			if (found)
+				break;
+			found = start <= (uintptr_t)me->array && (uintptr_t)me->array < end;
+		} else if (found) {
+			sscanf(line, "Size: %lu kB", &size_kb);
+			sscanf(line, "KernelPageSize: %lu kB", &page_kb);
+			sscanf(line, "AnonHugePages: %lu kB", &thp_kb);
+		}
+	}
+	fclose(f);
+
+	if (syscall(SYS_get_mempolicy, &node, NULL, 0, me->array, MPOL_F_NODE | MPOL_F_ADDR) == -1)
+		node = -1;
+
+	fprintf(stderr, "CPU %d memory: page size %lu KiB, transparent huge pages %lu of %lu KiB, NUMA node %d\n",
+		me->cpu, page_kb, thp_kb, size_kb, node);
+}
+
+/* Run the STREAM kernel repeatedly so that it accesses about
+ * cfg->read_count cache lines. Return the number of accessed cache
+ * lines. */
+static uint64_t do_stream(struct benchmark_thread *me)
+{
+	const struct stream_kernel *k = me->cfg->stream;
+	size_t n = me->cfg->size / sizeof(vec_t);
+	uint64_t lines = (uint64_t)n * sizeof(vec_t) / CACHE_LINE_SIZE * k->arrays;
+	uint64_t passes = me->cfg->read_count / lines ?: 1;
+
+	for (uint64_t i = 0; i < passes; i++)
+		k->func(me->stream[0], me->stream[1], me->stream[2], n);
+	return passes * lines;
+}
+
 static void *benchmark_thread(void *arg)
 {
 	struct benchmark_thread *me = arg;
-	cpu_set_t set;
+	cpu_set_t *set = cpulist_alloc();
 
-	CPU_ZERO(&set);
-	CPU_SET(me->cpu, &set);
+	CPU_SET_S(me->cpu, cpulist_setsize(), set);
 
-	if (pthread_setaffinity_np(me->id, sizeof(set), &set) != 0)
+	if (pthread_setaffinity_np(me->id, cpulist_setsize(), set) != 0)
 		errx(1, "Failed setting pthread_setaffinity_np to CPU %d", me->cpu);
+	CPU_FREE(set);
 
-	prepare(array[me->cpu], me->cfg->size, me->cfg->sequential);
+	if (me->cfg->stream) {
+		for (int i = 0; i < 3; i++) {
+			me->stream[i] = alloc_array(me->cfg);
+			for (size_t j = 0; j < me->cfg->size / sizeof(vec_t); j++)
+				me->stream[i][j] = (vec_t){} + (2 - i); /* a = 2, b = 1, c = 0 */
+		}
+		me->array = (struct s *)me->stream[0];
+	} else {
+		me->array = alloc_array(me->cfg);
+		struct timespec now;
+		clock_gettime(CLOCK_REALTIME, &now);
+		prepare(me->array, me->cfg->size, me->cfg->order,
+			me->cfg->pages == PAGES_HUGETLB ? me->cfg->huge_page_size : (size_t)sysconf(_SC_PAGESIZE),
+			(uint64_t)now.tv_sec * 1000000000 + now.tv_nsec + me->cpu);
+		if (me->cfg->chains) {
+			/* Start the chains evenly spaced along the list */
+			unsigned count = me->cfg->size / sizeof(struct s);
+			struct s *p = me->array;
+			for (unsigned i = 0, k = 0; k < me->cfg->chains; i++, p = p->ptr)
+				while (k < me->cfg->chains && i == (uint64_t)k * count / me->cfg->chains)
+					me->chain[k++] = p;
+		}
+	}
+	if (print)
+		report_memory(me);
 
 	pthread_barrier_wait(&barrier);
 
@@ -228,59 +563,117 @@ static void *benchmark_thread(void *arg)
 
         unsigned work_done = 0;
         do {
-                uint64_t tic, tac;
+                uint64_t tic, tac, accesses = me->cfg->read_count;
                 tic = get_time(me->cfg);
-                if (me->cfg->write == false)
-                        do_read(array[me->cpu], me->cfg->read_count);
+                if (me->cfg->stream)
+                        accesses = do_stream(me);
+                else if (me->cfg->chains)
+                        do_read_mlp(me->chain, me->cfg->read_count / me->cfg->chains, me->cfg->chains);
+                else if (me->cfg->write == false)
+                        do_read(me->array, me->cfg->read_count);
                 else
-                        do_write(array[me->cpu], me->cfg->read_count, me->cfg->ofs);
+                        do_write(me->array, me->cfg->read_count, me->cfg->ofs);
 
                 tac = get_time(me->cfg);
-                me->result = (double)(tac - tic) / me->cfg->read_count;
-                if (me->cfg->forever) {
+                me->result = (double)(tac - tic) / accesses;
+                if (me->cfg->forever && me->cfg->report_interval_ms) {
+                        __atomic_store_n(&me->work_done, ++work_done, __ATOMIC_RELAXED);
+                } else if (me->cfg->forever) {
                         printf("CPU%d_work_done=%u\n", me->cpu, work_done++);
                         printf("CPU%d size:%d time:%g\n", me->cpu, me->cfg->size, (tac - tic) / 1000000000.0);
 			fflush(stdout);
                 }
         } while (me->cfg->forever);
+	if (me->cfg->stream) {
+		for (int i = 0; i < 3; i++)
+			free_array(me->stream[i], me->cfg);
+	} else {
+		free_array(me->array, me->cfg);
+	}
+	return NULL;
+}
+
+struct reporter {
+	struct benchmark_thread *threads;
+	unsigned num_threads;
+	unsigned interval_ms;
+};
+
+/* Print work done by all threads at fixed time intervals */
+static void *reporter_thread(void *arg)
+{
+	struct reporter *r = arg;
+	struct timespec next;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (1) {
+		uint64_t ns = next.tv_nsec + (uint64_t)r->interval_ms * 1000000;
+		next.tv_sec += ns / 1000000000;
+		next.tv_nsec = ns % 1000000000;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+		for (unsigned i = 0; i < r->num_threads; i++)
+			printf("CPU%d_work_done=%u\n", r->threads[i].cpu,
+			       __atomic_load_n(&r->threads[i].work_done, __ATOMIC_RELAXED));
+		fflush(stdout);
+	}
 	return NULL;
 }
 
 static void run_benchmark(struct cfg *cfg)
 {
-	struct benchmark_thread thread[MAX_CPUS];
+	struct benchmark_thread *thread = CHECKNULL(calloc(cfg->num_threads, sizeof(*thread)));
 	unsigned i;
-	cpu_set_t set = cfg->cpu_set;
+	cpu_set_t *set;
 
-	if (CPU_COUNT(&set) == 0) {
+	if (cfg->cpu_set) {
+		set = cpulist_alloc();
+		CPU_OR_S(cpulist_setsize(), set, set, cfg->cpu_set);
+	} else {
 		/* If CPU affinity is not specified on the command
 		 * line, use the default affinity, we inherited from
 		 * our parent. */
-		sched_getaffinity(0, sizeof(set), &set);
+		set = cpulist_affinity();
 	}
+	if (CPU_COUNT_S(cpulist_setsize(), set) < (int)cfg->num_threads)
+		errx(1, "Not enough CPUs for %u threads", cfg->num_threads);
 
 	pthread_barrier_init(&barrier, NULL, cfg->num_threads);
 	for (i = 0; i < cfg->num_threads; i++) {
 		thread[i].cfg = cfg;
-		for (int j = 0; j < MAX_CPUS; j++) {
-			if (CPU_ISSET(j, &set)) {
+		for (int j = 0; j < cpulist_max_cpus(); j++) {
+			if (CPU_ISSET_S(j, cpulist_setsize(), set)) {
 				thread[i].cpu = j;
-				CPU_CLR(j, &set);
+				CPU_CLR_S(j, cpulist_setsize(), set);
 				break;
 			}
 		}
 		if (print)
 			fprintf(stderr, "Running thread %d on CPU %d\n", i, thread[i].cpu);
+		thread[i].work_done = 0;
 		pthread_create(&thread[i].id, NULL, benchmark_thread, &thread[i]);
 	}
+	if (cfg->forever && cfg->report_interval_ms) {
+		static struct reporter r;
+		pthread_t id;
+		r = (struct reporter){ thread, cfg->num_threads, cfg->report_interval_ms };
+		pthread_create(&id, NULL, reporter_thread, &r);
+	}
 	for (i = 0; i < cfg->num_threads; i++) {
 		pthread_join(thread[i].id, NULL);
 	}
 	pthread_barrier_destroy(&barrier);
+	CPU_FREE(set);
 
 	double sum = 0;
 	printf("%d", cfg->size);
-	for (i = 0; i < cfg->num_threads; i++) {
+	if (cfg->chains) {
+		/* Latency of each load, bandwidth is reported below if requested */
+		printf("\t%u", cfg->chains);
+		for (i = 0; i < cfg->num_threads; i++)
+			printf("\t%#.3g", thread[i].result * cfg->chains);
+	}
+	for (i = 0; i < cfg->num_threads && (cfg->report_bandwidth || !cfg->chains); i++) {
 		double number;
 		if (cfg->report_bandwidth == 0)
 			number = thread[i].result;
@@ -293,6 +686,7 @@ static void run_benchmark(struct cfg *cfg)
 		printf("\t∑%#.3g", sum);
 	printf("\n");
 	fflush(stdout);
+	free(thread);
 	print = false;
 }
 
@@ -308,18 +702,41 @@ static void print_help(char *argv[], struct cfg *dflt)
 	       "              specified by [unit] (one of K, M, G).\n"
 	       "  -c <count>  Count of read (or read-write) operations per benchmark\n"
 	       "              (default is %#x)\n"
-	       "  -C <CPU#>   Run the benchmark on given CPU# (can be specified\n"
-	       "              multiple times), also see -t; the default is to go from\n"
-	       "	      CPU 0 upwards\n"
+	       "  -C <CPUs>   Run the benchmark on given CPUs, e.g. 0-63,96-127\n"
+	       "              (can be specified multiple times), also see -t; the\n"
+	       "              default is to go from CPU 0 upwards\n"
 	       "  -f          Execute forever in a loop\n"
 	       "  -h          Show this help\n"
+	       "  -H <pages>  Pages backing the memory: thp (request transparent huge\n"
+	       "              pages), nothp (disable them), 2M or 1G (explicit huge\n"
+	       "              pages, which must be reserved in /sys/kernel/mm/hugepages);\n"
+	       "              the default is the system THP policy\n"
+	       "  -i <ms>     With -f, threads only count their iterations and a\n"
+	       "              reporter thread prints the counts of all threads\n"
+	       "              every <ms> milliseconds\n"
+	       "  -M <K>      Walk K (1-%d) independent pointer chains in parallel\n"
+	       "              to measure latency under memory-level parallelism;\n"
+	       "              K1-K2 runs the benchmark for all K in the range. Each\n"
+	       "              line then reports the size, K, latency of each load\n"
+	       "              per thread and, with -b, bandwidth per thread. Sizes\n"
+	       "              with fewer cache lines than K are skipped\n"
+	       "  -N <node>   Allocate memory from given NUMA node (default is the\n"
+	       "              node local to each thread)\n"
 	       "  -o <ofs>    Offset of write operation within the cache line (see -w)\n"
-	       "  -r          Traverse memory in random order (default is sequential)\n"
+	       "  -r[page]    Traverse memory in random order (default is sequential);\n"
+	       "              with page, all cache lines of a page are accessed in\n"
+	       "              random order before going to another random page,\n"
+	       "              which minimizes TLB misses\n"
+	       "  -S <kernel> Measure bandwidth with a STREAM kernel instead of\n"
+	       "              memory latency: copy, scale, add or triad with\n"
+	       "              <WSS> bytes per array, or their _nt variants with\n"
+	       "              non-temporal stores. Bandwidth is reported in GiB/s\n"
+	       "              unless -b specifies another unit\n"
 	       "  -s <WSS>    Run benchmark for given working set size; the default is\n"
 	       "              to benchmark a sequence of multiple WSSs\n"
 	       "  -t <#thr>   The number of benchmark threads to run; use -C to\n"
 	       "              specify their CPU affinity. If -C is specified, -t defaults\n"
-	       "              to the number of -C occurrences\n"
+	       "              to the number of given CPUs\n"
 	       "  -w          Perform both memory reads and writes (default is only\n"
 	       "              reads)\n"
 	       "  -y          Report the memory access duration in clock cycles rather\n"
@@ -329,27 +746,27 @@ static void print_help(char *argv[], struct cfg *dflt)
 	       "per memory operation.\n"
 	       ,
 	       argv[0],
-	       dflt->read_count);
+	       dflt->read_count, MAX_CHAINS);
 }
 
 int main(int argc, char *argv[])
 {
-	srand(time(NULL));
-
 	struct cfg cfg = {
-		.sequential = true,
+		.order = ORDER_SEQUENTIAL,
 		.num_threads = 0,
 		.size = 0,
 		.read_count = 0x2000000,
 		.write = false,
 		.ofs = 0,
 		.use_cycles = false, /* i.e. use nanoseconds */
+		.pages = PAGES_DEFAULT,
+		.node = -1,
 	};
-	CPU_ZERO(&cfg.cpu_set);
 	unsigned C_cnt = 0;
+	unsigned chains_min = 0, chains_max = 0;
 
 	int opt;
-	while ((opt = getopt(argc, argv, "b::c:C:fho:rs:t:wy")) != -1) {
+	while ((opt = getopt(argc, argv, "b::c:C:fhH:i:M:N:o:r::S:s:t:wy")) != -1) {
 		switch (opt) {
 		case 'b':
 			if (!optarg) {
@@ -371,24 +788,71 @@ int main(int argc, char *argv[])
 		case 'f':
 			cfg.forever = true;
 			break;
+		case 'H':
+			if (strcmp(optarg, "thp") == 0) {
+				cfg.pages = PAGES_THP;
+			} else if (strcmp(optarg, "nothp") == 0) {
+				cfg.pages = PAGES_NOTHP;
+			} else if (strcmp(optarg, "2M") == 0) {
+				cfg.pages = PAGES_HUGETLB;
+				cfg.huge_page_size = 2*1024*1024;
+			} else if (strcmp(optarg, "1G") == 0) {
+				cfg.pages = PAGES_HUGETLB;
+				cfg.huge_page_size = 1024*1024*1024;
+			} else {
+				errx(1, "Unsupported page type: %s", optarg);
+			}
+			break;
+		case 'i':
+			cfg.report_interval_ms = atol(optarg);
+			break;
+		case 'M': {
+			char *end;
+			chains_min = chains_max = strtoul(optarg, &end, 10);
+			if (*end == '-')
+				chains_max = strtoul(end + 1, &end, 10);
+			if (*end || chains_min < 1 || chains_max < chains_min || chains_max > MAX_CHAINS)
+				errx(1, "Invalid number of chains (1-%d): %s", MAX_CHAINS, optarg);
+			break;
+		}
+		case 'N':
+			cfg.node = atol(optarg);
+			if (cfg.node < 0)
+				errx(1, "Invalid NUMA node: %s", optarg);
+			break;
 		case 'o':
 			cfg.ofs = atol(optarg);
 			break;
 		case 'r':	/* random */
-			cfg.sequential = false;
+			if (!optarg)
+				cfg.order = ORDER_RANDOM;
+			else if (strcmp(optarg, "page") == 0)
+				cfg.order = ORDER_RANDOM_PAGES;
+			else
+				errx(1, "Unsupported random order: %s", optarg);
+			break;
+		case 'S':
+			for (unsigned i = 0; i < ARRAY_SIZE(stream_kernels); i++)
+				if (strcmp(optarg, stream_kernels[i].name) == 0)
+					cfg.stream = &stream_kernels[i];
+			if (!cfg.stream)
+				errx(1, "Unknown STREAM kernel: %s", optarg);
 			break;
 		case 's':
 			cfg.size = atol(optarg);
-                        if (cfg.size > sizeof(array[0]))
-                            errx(1, "Maximum size for -s is %zu", sizeof(array[0]));
 			break;
 		case 't':
 			cfg.num_threads = atol(optarg);
 			break;
-		case 'C':
-			CPU_SET(atol(optarg), &cfg.cpu_set);
-			C_cnt++;
+		case 'C': {
+			cpu_set_t *set = cpulist_parse(optarg, "-C");
+			if (!cfg.cpu_set)
+				cfg.cpu_set = cpulist_alloc();
+			CPU_OR_S(cpulist_setsize(), cfg.cpu_set, cfg.cpu_set, set);
+			C_cnt = CPU_COUNT_S(cpulist_setsize(), cfg.cpu_set);
+			CPU_FREE(set);
 			break;
+		}
 		case 'w':
 			cfg.write = true;
 			break;
@@ -413,23 +877,42 @@ int main(int argc, char *argv[])
 		assert(cfg.ofs < ARRAY_SIZE(s.dummy));
 	}
 
+	if (cfg.report_interval_ms && !cfg.forever)
+		errx(1, "Flag -i requires -f");
 	if (cfg.use_cycles && cfg.report_bandwidth)
 		errx(1, "Flags -y and -b are not compatible");
+	if (chains_min && (cfg.write || cfg.stream))
+		errx(1, "Flag -M is not compatible with -w and -S");
+	if (cfg.stream && cfg.use_cycles)
+		errx(1, "Flags -y and -S are not compatible");
+	if (cfg.stream && cfg.report_bandwidth == 0)
+		cfg.report_bandwidth = 1024*1024*1024;
+	if (cfg.stream && cfg.size != 0 && cfg.size < sizeof(vec_t))
+		errx(1, "Minimum size for -S is %zu", sizeof(vec_t));
 	if (cfg.use_cycles)
 		ccntr_init();
 
-	if (cfg.size != 0) {
-		run_benchmark(&cfg);
-	} else {
-		unsigned order, size, step;
-		for (order = 10; order <= 24; order++) {
-			for (step = 0; step < 2; step++) {
-				size = 1 << order;
-				if (step == 1)
-					size += size / 2;
-
-				cfg.size = size;
-				run_benchmark(&cfg);
+	unsigned wss = cfg.size;
+	/* Chains must start at different places so that they never meet */
+	if (wss != 0 && chains_max > wss / sizeof(struct s))
+		errx(1, "Size %u has only %zu cache lines, fewer than %u chains",
+		     wss, wss / sizeof(struct s), chains_max);
+	for (cfg.chains = chains_min; cfg.chains <= chains_max; cfg.chains++) {
+		if (wss != 0) {
+			run_benchmark(&cfg);
+		} else {
+			unsigned order, size, step;
+			for (order = 10; order <= 24; order++) {
+				for (step = 0; step < 2; step++) {
+					size = 1 << order;
+					if (step == 1)
+						size += size / 2;
+
+					cfg.size = size;
+					if (size / sizeof(struct s) < cfg.chains)
+						continue;
+					run_benchmark(&cfg);
+				}
 			}
 		}
 	}
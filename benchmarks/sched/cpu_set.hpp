@@ -1,22 +1,25 @@
 #ifndef CPU_SET_HPP
 #define CPU_SET_HPP
 
+#include "cpulist.h"
+#include <cstdlib>
 #include <cstring>
 #include <sched.h>
 #include <stdexcept>
+#include <string>
 
-// C++ wrapper over C's cpu_set_t
+// C++ wrapper over C's cpu_set_t. The size of the set is determined at
+// runtime (see cpulist.h).
 class cpu_set {
 public:
-    static constexpr int max_cpus = 64;
+    static int max_cpus() { return cpulist_max_cpus(); }
 
     cpu_set()
-        : s(CPU_ALLOC(max_cpus))
+        : s(cpulist_alloc())
     {
-        zero();
     }
     cpu_set(const cpu_set &o)
-        : s(CPU_ALLOC(max_cpus))
+        : s(cpulist_alloc())
     {
         memcpy(s, o.s, size());
     }
@@ -25,12 +28,10 @@ public:
     {
         o.s = nullptr;
     }
-    cpu_set(long int mask)
-        : cpu_set()
+    // Parse CPU list or hexadecimal mask (see cpulist_parse_compat())
+    cpu_set(const char *cpulist, const char *err_msg)
+        : s(cpulist_parse_compat(cpulist, err_msg))
     {
-        for (size_t i = 0; i < sizeof(mask) * 8; i++)
-            if (mask & (1UL << i))
-                set(i);
     }
     ~cpu_set() { CPU_FREE(s); }
 
@@ -56,15 +57,14 @@ public:
     bool operator==(cpu_set &o) { return CPU_EQUAL_S(size(), s, o.s); }
     bool operator!=(cpu_set &o) { return !(o == *this); }
     unsigned count() const { return CPU_COUNT_S(size(), s); }
-    size_t size() const { return CPU_ALLOC_SIZE(max_cpus); }
+    size_t size() const { return cpulist_setsize(); }
     cpu_set_t *ptr() const { return s; }
-    int as_int() const
+    std::string str() const
     {
-        int mask = 0;
-        for (int i = 0; i < max_cpus; i++)
-            if (is_set(i))
-                mask |= 1 << i;
-        return mask;
+        char *list = cpulist_format(s);
+        std::string ret(list);
+        free(list);
+        return ret;
     }
     explicit operator bool() const { return count() > 0; }
 
@@ -79,14 +79,14 @@ public:
 
     unsigned highest() const
     {
-        for (int i = max_cpus - 1; i >= 0; i--)
+        for (int i = max_cpus() - 1; i >= 0; i--)
             if (is_set(i))
                 return i;
         throw std::runtime_error("empty cpu_set");
     }
     unsigned lowest() const
     {
-        for (int i = 0; i < max_cpus; i++)
+        for (int i = 0; i < max_cpus(); i++)
             if (is_set(i))
                 return i;
         throw std::runtime_error("empty cpu_set");
@@ -97,7 +97,7 @@ public:
         do {
             if (is_set(i))
                 return i;
-            i = (i + 1) % max_cpus;
+            i = (i + 1) % max_cpus();
         } while (i != j + 1);
         throw std::runtime_error("empty cpu_set");
     }
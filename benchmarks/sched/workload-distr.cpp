@@ -143,23 +143,26 @@ int main(int argc, char *argv[])
             loops_per_print = xstrtol(optarg, "-l");
             break;
         case 'm': {
-            cpu_set m(xstrtol(optarg, "-m"));
+            cpu_set m(optarg, "-m");
             if (!m)
-                errx(1, "Mask cannot be 0");
+                errx(1, "Mask cannot be empty");
             if (m ^ (m & cpu_mask))
-                errx(1, "Invalid CPU(s) in mask; given: %#x, allowed: %#x", m.as_int(), cpu_mask.as_int());
+                errx(1, "Invalid CPU(s) in mask; given: %s, allowed: %s", m.str().c_str(), cpu_mask.str().c_str());
             cpu_mask &= m;
             break;
         }
         case 'i': {
-            cpu_set m(xstrtol(optarg, "-i"));
+            cpu_set m(optarg, "-i");
             if (!m)
-                errx(1, "Initial mask cannot be 0");
+                errx(1, "Initial mask cannot be empty");
             s.run = m;
             break;
         }
         default: /* '?' */
-            fprintf(stderr, "Usage: %s [-l loops ] [-m cpu_mask]\n", argv[0]);
+            fprintf(stderr,
+                    "Usage: %s [-l loops ] [-m cpu_list] [-i cpu_list]\n"
+                    "cpu_list is e.g. 0-3,8 or a hexadecimal mask 0xff; decimal masks are not accepted\n",
+                    argv[0]);
             exit(1);
         }
     }
@@ -172,14 +175,15 @@ int main(int argc, char *argv[])
     s.num_cpus = s.run.count();
     s.first_cpu = s.run.lowest();
 
-    for (int i = 0; i < cpu_mask.max_cpus; i++) {
+    for (int i = 0; i < cpu_mask.max_cpus(); i++) {
         if (!cpu_mask.is_set(i))
             continue;
 
         pthread_attr_t attr;
-        cpu_set cpuset(1 << i);
+        cpu_set cpuset;
         pthread_t tid;
 
+        cpuset.set(i);
         pthread_attr_init(&attr);
         pthread_attr_setaffinity_np(&attr, cpuset.size(), cpuset.ptr());
         pthread_create(&tid, &attr, benchmark_loop, (void *)(intptr_t)i);
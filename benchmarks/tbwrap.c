@@ -26,6 +26,7 @@ struct arguments {
     uint64_t work_done_every;
     uint64_t work_done_every_msec;
     bool time;
+    bool phases;
 };
 
 /* Program documentation. */
@@ -43,6 +44,7 @@ static struct argp_option options[] = {
     {"work_done_every", 'e', "NUM",   0, "Print \"work_done\" message every NUM iterations. Defaults to 1." },
     {"work_done_every_sec", 's', "NUM",   0, "Print \"work_done\" approximately every NUM seconds. When non-zero, overrides --work_done_every." },
     {"time",            't', 0,       0, "Measure and print execution time of the benchmark." },
+    {"phases",          'p', 0,       0, "Print @phase=run and @phase=done lines around the benchmark loop (see thermobench --phases)." },
 
     { 0 }
 };
@@ -71,6 +73,9 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
     case 't':
         arguments->time = true;
         break;
+    case 'p':
+        arguments->phases = true;
+        break;
     case ARGP_KEY_ARG:
         return ARGP_ERR_UNKNOWN;
     default:
@@ -157,6 +162,14 @@ static void print_work_done(uint64_t work_done)
     }
 }
 
+static void print_phase(const char *name)
+{
+    if (arguments.phases) {
+        printf("@phase=%s\n", name);
+        fflush(stdout);
+    }
+}
+
 struct tictac {
     struct timespec tic, tac;
 };
@@ -182,6 +195,7 @@ void thermobench_wrap(void (*f)())
 
     parse_tb_opts();
 
+    print_phase("run");
     tic(&tictac);
 
     uint64_t i;
@@ -194,4 +208,5 @@ void thermobench_wrap(void (*f)())
 
     tac(&tictac);
     print_work_done(i);
+    print_phase("done");
 }
@@ -33,6 +33,14 @@ void CsvColumns::setHeader(CsvRow &row)
     }
 }
 
+const CsvColumn *CsvColumns::find(const string &header) const
+{
+    for (const CsvColumn &column : columns)
+        if (column.getHeader() == header)
+            return &column;
+    return NULL;
+}
+
 /* CsvRow implementation */
 void CsvRow::set(const CsvColumn &column, double data)
 {
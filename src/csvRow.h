@@ -33,6 +33,9 @@ public:
 
     void setHeader(CsvRow &row);
 
+    // Return column with the given header or NULL
+    const CsvColumn *find(const string &header) const;
+
     size_t count() const { return columns.size(); }
 };
 
@@ -0,0 +1,106 @@
+#include "stats.h"
+#include <algorithm>
+
+/* TDigest implementation */
+
+void TDigest::add(double x)
+{
+    buffer.push_back(x);
+    if (isnan(min) || x < min)
+        min = x;
+    if (isnan(max) || x > max)
+        max = x;
+    if (buffer.size() >= 5 * compression)
+        compress();
+}
+
+void TDigest::compress()
+{
+    if (buffer.empty())
+        return;
+
+    vector<centroid> all;
+    all.reserve(centroids.size() + buffer.size());
+    all.insert(all.end(), centroids.begin(), centroids.end());
+    for (double x : buffer)
+        all.push_back({ x, 1 });
+    total += buffer.size();
+    buffer.clear();
+    sort(all.begin(), all.end(), [](const centroid &a, const centroid &b) { return a.mean < b.mean; });
+
+    // Merge neighbouring centroids while their weight stays below the
+    // size limit, which is small at the tails and large in the middle.
+    centroids.clear();
+    centroid cur = all[0];
+    double cum = 0; // Weight of centroids before cur
+    for (size_t i = 1; i < all.size(); i++) {
+        double q = (cum + (cur.weight + all[i].weight) / 2) / total;
+        double limit = 4 * total * q * (1 - q) / compression;
+        if (cur.weight + all[i].weight <= std::max(limit, 1.0)) {
+            cur.mean += (all[i].mean - cur.mean) * all[i].weight / (cur.weight + all[i].weight);
+            cur.weight += all[i].weight;
+        } else {
+            cum += cur.weight;
+            centroids.push_back(cur);
+            cur = all[i];
+        }
+    }
+    centroids.push_back(cur);
+}
+
+double TDigest::quantile(double q)
+{
+    compress();
+    if (centroids.empty())
+        return NAN;
+    if (centroids.size() == 1)
+        return centroids[0].mean;
+
+    // Interpolate between centroid centers, using min and max at the ends
+    double index = q * total;
+    if (index <= centroids[0].weight / 2)
+        return min + (centroids[0].mean - min) * index / (centroids[0].weight / 2);
+    double cum = 0;
+    for (size_t i = 0; i + 1 < centroids.size(); i++) {
+        const centroid &a = centroids[i], &b = centroids[i + 1];
+        double center_a = cum + a.weight / 2;
+        double center_b = cum + a.weight + b.weight / 2;
+        if (index <= center_b)
+            return a.mean + (b.mean - a.mean) * (index - center_a) / (center_b - center_a);
+        cum += a.weight;
+    }
+    const centroid &last = centroids.back();
+    double center = total - last.weight / 2;
+    return last.mean + (max - last.mean) * (index - center) / (last.weight / 2);
+}
+
+/* ColumnStats implementation */
+
+void ColumnStats::add(double t, double v)
+{
+    n++;
+    double delta = v - m_mean;
+    m_mean += delta / n;
+    m2 += delta * (v - m_mean);
+    if (isnan(m_min) || v < m_min)
+        m_min = v;
+    if (isnan(m_max) || v > m_max)
+        m_max = v;
+    digest.add(v);
+
+    if (isnan(first_t)) {
+        first_t = t;
+        first_v = v;
+    } else if (v < last_v) {
+        monotonic = false;
+    }
+    last_t = t;
+    last_v = v;
+}
+
+double ColumnStats::rate() const
+{
+    if (!monotonic || !(last_t > first_t) || last_v == first_v)
+        return NAN;
+    return (last_v - first_v) / (last_t - first_t) * 1000;
+}
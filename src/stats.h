@@ -0,0 +1,66 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <math.h>
+#include <vector>
+
+using namespace std;
+
+// Streaming quantile estimation with bounded memory (merging t-digest,
+// see Dunning & Ertl: Computing Extremely Accurate Quantiles Using
+// t-Digests).
+class TDigest {
+private:
+    struct centroid {
+        double mean;
+        double weight;
+    };
+    double compression;
+    vector<centroid> centroids = {};
+    vector<double> buffer = {};
+    double total = 0;
+    double min = NAN, max = NAN;
+
+    void compress();
+
+public:
+    TDigest(double compression = 100)
+        : compression(compression)
+    {
+    }
+
+    void add(double x);
+
+    // Estimate q-quantile (0 ≤ q ≤ 1) of the added values
+    double quantile(double q);
+};
+
+// Count, mean and variance (Welford's algorithm), extremes, quantiles
+// and rate of change of a stream of samples.
+class ColumnStats {
+private:
+    unsigned long n = 0;
+    double m_mean = 0, m2 = 0;
+    double m_min = NAN, m_max = NAN;
+    double first_t = NAN, first_v = NAN, last_t = NAN, last_v = NAN;
+    bool monotonic = true;
+    TDigest digest {};
+
+public:
+    // Add value v sampled at time t [ms]
+    void add(double t, double v);
+
+    unsigned long count() const { return n; }
+    double mean() const { return n ? m_mean : NAN; }
+    double stddev() const { return n > 1 ? sqrt(m2 / (n - 1)) : NAN; }
+    double min() const { return m_min; }
+    double max() const { return m_max; }
+    double last() const { return last_v; }
+    double quantile(double q) { return digest.quantile(q); }
+
+    // Rate of change [1/s] of non-decreasing values (counters such as
+    // work_done). NAN for other values.
+    double rate() const;
+};
+
+#endif
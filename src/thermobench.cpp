@@ -9,19 +9,29 @@
 #define _POSIX_C_SOURCE 200809L
 #include "csvRow.h"
 #include "sched_deadline.h"
+#include "stats.h"
 #include "util.hpp"
 #include <algorithm>
 #include <argp.h>
+#include <deque>
 #include <err.h>
+#include <functional>
 #include <errno.h>
 #include <ext/stdio_filebuf.h>
+#include <dirent.h>
 #include <fcntl.h>
 #include <iostream>
 #include <libgen.h>
+#include <linux/magic.h>
+#include <map>
+#include <mutex>
+#include <netdb.h>
 #include <math.h>
 #include <mcheck.h>
 #include <memory>
+#include <regex>
 #include <sched.h>
+#include <set>
 #include <signal.h>
 #include <sstream>
 #include <stdio.h>
@@ -30,7 +40,14 @@
 #include <string>
 #include <string_view>
 #include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
 #include <sys/wait.h>
+#include <thread>
 #include <time.h>
 #include <unistd.h>
 #include <vector>
@@ -99,6 +116,13 @@ using namespace std;
         };                                                                                                             \
     })
 
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434 // Same number on all architectures
+#endif
+#ifndef SYS_pidfd_send_signal
+#define SYS_pidfd_send_signal 424
+#endif
+
 #define MAX_RESULTS 100
 #define MAX_KEYS 20
 #define MAX_KEY_LENGTH 50
@@ -112,6 +136,7 @@ struct sensor {
     string name;
     const string units;
     const CsvColumn &column;
+    mutable int fd = -1; // Kept open between readings (sysfs only)
     sensor(const char *spec)
         : path(extractPath(spec))
         , name(extractName(spec))
@@ -149,6 +174,7 @@ vector<struct cpu> cpus;
 
 const CsvColumn &time_column = columns.add("time/ms");
 const CsvColumn *stdout_column = NULL;
+const CsvColumn *phase_column = NULL;
 
 /* Command line options */
 int measure_period_ms = 1000;
@@ -157,122 +183,378 @@ char *benchmark_path[2] = { NULL, NULL };
 char **benchmark_argv = NULL;
 double cooldown_temp = NAN;
 int cooldown_timeout = 600;
+int cooldown_period_ms = 2000;
+const char *cooldown_sensors = NULL;
+// Stability criterion: temperature at most TEMP + tolerance and slope within
+// ±cooldown_slope for cooldown_hold seconds
+bool cooldown_stable = false;
+double cooldown_tolerance = 1;   // °C
+double cooldown_slope = 0.2;     // °C/min
+double cooldown_hold = 30;       // s
+double cooldown_kp = NAN, cooldown_ki = 0, cooldown_kd = 0; // PID fan control
 char *fan_cmd = NULL;
+bool fan_stdin = false;
 float fan_on = NAN;
 char *bench_name = NULL;
 const char *output_path = ".";
 char *out_file = NULL;
 bool write_stdout = false;
 int terminate_time = 0;
+int baseline_time = 0;
+const char *steady_sensors = NULL;
+double steady_slope = NAN;  // °C/min, NAN means no steady-state detection
+double steady_window = 60;  // s
+bool fit_enabled = false;
+const char *fit_sensors = NULL;
+double fit_stop = NAN; // °C, NAN means do not terminate based on the fit
+const char *jobs_file = NULL;
+vector<string> corun_specs;
+bool has_affinity = false;
+cpu_set_t affinity; // of COMMAND
 bool calc_cpu_usage = false;
+bool track_phases = false;
+bool stats_enabled = false;
+char *metrics_addr = NULL;
+vector<string> trigger_specs;
+double kill_timeout = 5; // s
 bool exec_wait = false;
+bool exec_direct = false;
 bool verbose = false;
 bool verbose_needs_eol = false;
+bool interrupted = false;
 bool csv_unbuffered = false;
 bool sched_deadline = false;
 float sched_deadline_budget = 1.0; // %
 
+// How are multiple values received between two sensor readings
+// combined into a single CSV value (for synchronous columns)
+enum class Aggregation { last, mean, min, max, sum, count };
+
 struct StdoutKeyColumn {
     const CsvColumn &column;
     const string key;
     const bool synchronous; // Value stored every --period, not immediately
+    const Aggregation aggregation;
     string last_value = ""; // Last value (for synchronous columns)
-    StdoutKeyColumn(const string header, const string key, bool synchronous)
+    // Accumulators for numeric aggregations
+    unsigned count = 0;
+    double sum = 0, min = INFINITY, max = -INFINITY;
+
+    StdoutKeyColumn(const string header, const string key, bool synchronous,
+                    Aggregation aggregation = Aggregation::last)
         : column(columns.add(header))
         , key(key)
-        , synchronous(synchronous) {};
+        , synchronous(synchronous)
+        , aggregation(aggregation) {};
+
+    void add_value(string &&value);
+    void store(CsvRow &row);
+    void reset();
+
+    static Aggregation parse_aggregation(const string &name);
+    static const char *aggregation_name(Aggregation a);
 };
 
+Aggregation StdoutKeyColumn::parse_aggregation(const string &name)
+{
+    for (auto a : { Aggregation::last, Aggregation::mean, Aggregation::min, Aggregation::max, Aggregation::sum,
+                    Aggregation::count })
+        if (name == aggregation_name(a))
+            return a;
+    errx(1, "Unknown aggregation '%s'", name.c_str());
+}
+
+const char *StdoutKeyColumn::aggregation_name(Aggregation a)
+{
+    switch (a) {
+    case Aggregation::last:
+        return "last";
+    case Aggregation::mean:
+        return "mean";
+    case Aggregation::min:
+        return "min";
+    case Aggregation::max:
+        return "max";
+    case Aggregation::sum:
+        return "sum";
+    case Aggregation::count:
+        return "count";
+    }
+    return "";
+}
+
+// Remember the value received from stdout until the next store()
+void StdoutKeyColumn::add_value(string &&value)
+{
+    switch (aggregation) {
+    case Aggregation::last:
+        last_value = move(value);
+        break;
+    case Aggregation::count:
+        count++;
+        break;
+    default: {
+        char *end;
+        double v = strtod(value.c_str(), &end);
+        if (end == value.c_str())
+            break; // Ignore non-numeric values
+        count++;
+        sum += v;
+        min = fmin(min, v);
+        max = fmax(max, v);
+    }
+    }
+}
+
+// Store the (aggregated) value to the row and reset the accumulators
+void StdoutKeyColumn::store(CsvRow &row)
+{
+    switch (aggregation) {
+    case Aggregation::last:
+        row.set(column, move(last_value));
+        break;
+    case Aggregation::count:
+        row.set(column, count);
+        break;
+    case Aggregation::sum:
+        row.set(column, sum);
+        break;
+    case Aggregation::mean:
+        if (count)
+            row.set(column, sum / count);
+        break;
+    case Aggregation::min:
+        if (count)
+            row.set(column, min);
+        break;
+    case Aggregation::max:
+        if (count)
+            row.set(column, max);
+        break;
+    }
+    reset();
+}
+
+// Forget the values received since the last store()
+void StdoutKeyColumn::reset()
+{
+    last_value.erase();
+    count = 0;
+    sum = 0;
+    min = INFINITY;
+    max = -INFINITY;
+}
+
 vector<string> split(const string str, const char *delimiters);
+vector<string> split_words(const string str);
 
-struct Exec {
-    const string cmd;
+// Child process watched via pidfd. Unlike with ev::child, there is no
+// race between fork() and starting the watcher and the pid cannot be
+// recycled before we reap the process.
+struct Process {
+    pid_t pid = 0;
+    int status = 0;
+    struct rusage usage = {};
+    function<void()> on_exit = nullptr;
+
+    Process() = default;
+    Process(const Process &) = delete;
+    void operator=(const Process &) = delete;
+
+    void watch(ev::loop_ref loop, pid_t pid);
+    // Send SIGTERM to the process group and SIGKILL after kill_timeout
+    void terminate();
+    bool running() const { return pid > 0; }
+    bool terminating() const { return kill_timer.is_active() || (running() && term_sent); }
+
+private:
+    int pidfd = -1;
+    bool term_sent = false;
+    ev::io exit_watcher = {};
+    ev::timer kill_timer = {};
+
+    void signal(int sig);
+    void exit_cb(ev::io &w, int revents);
+    void kill_cb(ev::timer &w, int revents);
+};
+
+// Processes tracked by Process (and the fan co-process). Other
+// children are orphans of the benchmarks (see kill_orphans).
+set<pid_t> tracked_pids;
+
+// Common part of --exec and --input: parsing of lines received via a
+// file descriptor and storing them into relevant CSV columns
+struct LineSource {
     vector<StdoutKeyColumn> columns;
     StdoutKeyColumn *const stdout_col;
     const bool has_sync_column;
 
-    Exec(const string &arg)
-        : cmd(parse_cmd(arg))
-        , columns(parse_columns(arg))
+    LineSource(vector<StdoutKeyColumn> &&cols)
+        : columns(move(cols))
         , stdout_col(find_stdout_col(columns))
         , has_sync_column(any_of(begin(columns), end(columns), [](const auto &c) { return c.synchronous; }))
     {
     }
+    virtual ~LineSource() = default;
 
-    Exec(const Exec &) = delete;
-    void operator=(const Exec &) = delete;
+    LineSource(const LineSource &) = delete;
+    void operator=(const LineSource &) = delete;
 
-    void start(ev::loop_ref loop);
-    void kill();
+    virtual void start(ev::loop_ref loop) = 0;
+    virtual void kill() = 0;
+    // Is the source started together with COMMAND (i.e. after
+    // --baseline) rather than before sampling starts?
+    virtual bool with_benchmark() const { return false; }
 
-private:
-    static vector<string> get_specs(const string &arg);
-    static const string parse_cmd(const string &arg);
-    static vector<StdoutKeyColumn> parse_columns(const string &arg);
+protected:
+    static const string parse_arg(const string &arg, const char *opt);
+    static vector<string> get_specs(const string &arg, const char *opt);
+    static vector<StdoutKeyColumn> parse_columns(const string &arg, const char *opt, const string &default_col);
     static StdoutKeyColumn *find_stdout_col(vector<StdoutKeyColumn> &keys);
-    pid_t pid = 0;
+
     unique_ptr<__gnu_cxx::stdio_filebuf<char>> buf = nullptr;
-    ev::child child = {};
-    ev::io child_stdout = {};
+    ev::io input = {};
+
+    void start_reading(ev::loop_ref loop, int fd);
+    void stop_reading();
+    void input_cb(ev::io &w, int revents);
+    // Called when end of input is reached
+    virtual void input_eof() { input.stop(); }
+};
+
+struct Exec : public LineSource {
+    const string cmd;
+
+    Exec(const string &arg)
+        : LineSource(parse_columns(arg, "--exec", first_word(parse_arg(arg, "--exec"))))
+        , cmd(parse_arg(arg, "--exec"))
+    {
+    }
+
+    void start(ev::loop_ref loop) override;
+    void kill() override;
+
+protected:
+    Exec(vector<StdoutKeyColumn> &&cols, const string &cmd)
+        : LineSource(move(cols))
+        , cmd(cmd)
+    {
+    }
+
+    static string first_word(const string &cmd) { return cmd.substr(0, cmd.find_first_of(" \t")); }
+    Process proc = {};
+    bool has_affinity = false;
+    cpu_set_t affinity = {};
+
+private:
+    void child_exit_cb();
+};
+
+// Benchmark running concurrently with COMMAND (--corun). It is
+// started and killed together with COMMAND and the values it prints
+// are stored in columns prefixed with its name.
+struct Corun : public Exec {
+    const string name;
+
+    Corun(const string &name, const string &cmd, const cpu_set_t *cpus);
+
+    void start(ev::loop_ref loop) override;
+    void kill() override;
+    bool with_benchmark() const override { return true; }
 
-    void child_stdout_cb(ev::io &w, int revents);
-    void child_exit_cb(ev::child &w, int revents);
+    static Corun *parse(const string &arg);
+
+private:
+    static vector<StdoutKeyColumn> make_columns(const string &name);
+};
+
+// Reads lines from a Unix domain socket or a named pipe (FIFO)
+struct Input : public LineSource {
+    const string path;
+
+    Input(const string &arg)
+        : LineSource(parse_columns(arg, "--input", basename(parse_arg(arg, "--input"))))
+        , path(parse_arg(arg, "--input"))
+    {
+    }
+
+    void start(ev::loop_ref loop) override;
+    void kill() override;
+
+private:
+    static string basename(const string &path) { return path.substr(path.find_last_of('/') + 1); }
+    ev::timer reconnect = {};
+    bool warned = false;
+
+    void connect();
+    void reconnect_cb(ev::timer &w, int revents);
+    void input_eof() override;
 };
 
-const string Exec::parse_cmd(const string &arg)
+const string LineSource::parse_arg(const string &arg, const char *opt)
 {
     string cmd;
     if (arg[0] != '(')
         cmd = arg;
     else
         cmd = arg.substr(arg.find_first_of(")") + 1);
-    if (cmd.find_first_not_of(" \t\r\n") == string::npos)
-        errx(1, "--exec: No command");
-    return cmd;
+    size_t start = cmd.find_first_not_of(" \t\r\n");
+    if (start == string::npos)
+        errx(1, "%s: No %s", opt, strcmp(opt, "--exec") == 0 ? "command" : "path");
+    return cmd.substr(start);
 }
 
-vector<string> Exec::get_specs(const string &arg)
+vector<string> LineSource::get_specs(const string &arg, const char *opt)
 {
     size_t spec_end = arg.find_first_of(")");
     if (spec_end == string::npos)
-        errx(1, "--exec: Missing ')'");
+        errx(1, "%s: Missing ')'", opt);
 
     vector<string> specs = split(arg.substr(1, spec_end - 1), ",");
     if (specs.empty())
-        errx(1, "--exec: No columns specified");
+        errx(1, "%s: No columns specified", opt);
     return specs;
 }
 
-vector<StdoutKeyColumn> Exec::parse_columns(const string &arg)
+vector<StdoutKeyColumn> LineSource::parse_columns(const string &arg, const char *opt, const string &default_col)
 {
     vector<StdoutKeyColumn> keys;
 
     if (arg[0] == '(') {
-        vector<string> specs = get_specs(arg);
+        vector<string> specs = get_specs(arg, opt);
 
         const StdoutKeyColumn *catch_all = nullptr;
 
         for (string spec : specs) {
             bool synchronous = spec.front() == '@';
-            if (synchronous)
+            Aggregation aggregation = Aggregation::last;
+            string suffix;
+            if (synchronous) {
                 spec.erase(0, 1); // Remove '@'
+                size_t colon = spec.find_first_of(':');
+                if (colon != string::npos) {
+                    aggregation = StdoutKeyColumn::parse_aggregation(spec.substr(0, colon));
+                    suffix = string("_") + StdoutKeyColumn::aggregation_name(aggregation);
+                    spec.erase(0, colon + 1); // Remove 'OP:'
+                }
+            }
             if (spec.back() == '=') {
                 spec.pop_back(); // Remove '='
-                keys.push_back(StdoutKeyColumn(spec, spec, synchronous));
+                keys.push_back(StdoutKeyColumn(spec + suffix, spec, synchronous, aggregation));
             } else {
                 if (catch_all != nullptr)
-                    errx(1, "--exec: At most one COL without '=' allowed");
-                keys.push_back(StdoutKeyColumn(spec, "", synchronous));
+                    errx(1, "%s: At most one COL without '=' allowed", opt);
+                keys.push_back(StdoutKeyColumn(spec + suffix, "", synchronous, aggregation));
                 catch_all = &keys.back();
             }
         }
     } else {
-        keys.push_back(StdoutKeyColumn(arg.substr(0, arg.find_first_of(" \t")), "", false));
+        keys.push_back(StdoutKeyColumn(default_col, "", false));
     }
     return keys;
 }
 
-StdoutKeyColumn *Exec::find_stdout_col(vector<StdoutKeyColumn> &columns)
+StdoutKeyColumn *LineSource::find_stdout_col(vector<StdoutKeyColumn> &columns)
 {
     for (auto &col : columns)
         if (col.key.empty())
@@ -285,13 +567,15 @@ struct measure_state {
     vector<sensor> sensors = {};
     FILE *out_fp = nullptr;
     vector<StdoutKeyColumn> stdoutColumns = {};
-    vector<unique_ptr<Exec>> execs = {};
-    pid_t child = 0;
+    vector<unique_ptr<LineSource>> sources = {};
+    Process child = {};
+    bool started = false; // Was the benchmark started?
 } state;
 
 ev_timer measure_timer;
 ev_timer randomized_timer;
 ev_timer terminate_timer;
+ev_timer start_timer;
 ev_signal sigint_watcher, sigterm_watcher;
 
 void verbose_ensure_eol()
@@ -366,7 +650,9 @@ static void read_sensor_paths(char *sensors_file)
         if (line[0] == '#')
             continue;
         if (line[0] == '!') {
-            state.execs.emplace_back(new Exec(line + 1));
+            state.sources.emplace_back(new Exec(line + 1));
+        } else if (line[0] == '<') {
+            state.sources.emplace_back(new Input(line + 1));
         } else {
             state.sensors.push_back(sensor(line));
         }
@@ -388,55 +674,278 @@ static void add_all_thermal_zones()
     }
 }
 
-static double read_sensor(const char *path)
+static double read_sensor(const sensor &s)
 {
-    double result;
-    FILE *fp = fopen(path, "r");
-    if (fp == NULL)
-        err(1, "Error while opening sensor file: %s", path);
-    int scanret = fscanf(fp, "%lf", &result);
-    if (scanret != 1) // read fail or file empty
-        result = NAN;
-    fclose(fp);
+    // Sysfs attributes are regenerated whenever they are read from
+    // the beginning, so their files are opened only once. Other files
+    // (e.g. written by a script via rename()) may be replaced between
+    // readings and are reopened every time.
+    int fd = s.fd;
+    if (fd == -1) {
+        fd = open(s.path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+            err(1, "Error while opening sensor file: %s", s.path.c_str());
+        struct statfs fs;
+        if (fstatfs(fd, &fs) == 0 && fs.f_type == SYSFS_MAGIC)
+            s.fd = fd;
+    }
+    char buf[64];
+    ssize_t len = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (fd != s.fd)
+        close(fd);
+    if (len <= 0) // read fail or file empty
+        return NAN;
+    buf[len] = 0;
+    char *end;
+    double result = strtod(buf, &end);
+    return end == buf ? NAN : result;
+}
+
+static double ms_since(const struct timespec &start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return 1000 * (now.tv_sec - start.tv_sec + (now.tv_nsec - start.tv_nsec) * 1e-9);
+}
+
+static void timespec_add_ms(struct timespec &t, long ms)
+{
+    t.tv_sec += ms / 1000;
+    t.tv_nsec += ms % 1000 * 1000000;
+    if (t.tv_nsec >= 1000000000) {
+        t.tv_sec++;
+        t.tv_nsec -= 1000000000;
+    }
+}
+
+// Fan command running as a co-process (--fan-stdin)
+static pid_t fan_pid = 0;
+static FILE *fan_in = NULL, *fan_out = NULL;
+
+void start_fan_coproc(const char *fan_cmd)
+{
+    int in[2], out[2];
+    CHECK(pipe2(in, O_CLOEXEC));
+    CHECK(pipe2(out, O_CLOEXEC));
+
+    fan_pid = CHECK(fork());
+    if (fan_pid == 0) {
+        setpgid(0, 0); // Run in background process group to not receive SIGINT from terminal
+        CHECK(dup2(in[0], STDIN_FILENO));
+        CHECK(dup2(out[1], STDOUT_FILENO));
+        execl("/bin/sh", "/bin/sh", "-c", fan_cmd, NULL);
+        err(1, "exec(/bin/sh)");
+    }
+    close(in[0]);
+    close(out[1]);
+    fan_in = fdopen(in[1], "w");
+    fan_out = fdopen(out[0], "r");
+    if (!fan_in || !fan_out)
+        err(1, "fdopen");
+}
+
+void stop_fan_coproc()
+{
+    if (fan_pid == 0)
+        return;
+    fclose(fan_in); // The co-process should exit on EOF
+    fclose(fan_out);
+    waitpid(fan_pid, NULL, 0);
+    fan_pid = 0;
+}
+
+// Returns the time needed to set the speed in milliseconds
+double set_fan(char *fan_cmd, float speed, bool report = true)
+{
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (fan_pid) {
+        // Send the speed and wait for the acknowledgment line
+        char ack[100];
+        if (fprintf(fan_in, "%g\n", speed) < 0 || fflush(fan_in) == EOF)
+            err(1, "Writing to fan command '%s'", fan_cmd);
+        if (fgets(ack, sizeof(ack), fan_out) == NULL)
+            errx(1, "Fan command '%s' did not acknowledge speed %g", fan_cmd, speed);
+    } else {
+        char *cmd;
+        CHECK(asprintf(&cmd, "%s %g", fan_cmd, speed));
+        if (system(cmd) == -1)
+            err(1, "Error while executing shell command: %s\n", cmd);
+        free(cmd);
+    }
+
+    double duration = ms_since(start);
+    if (verbose && report) {
+        verbose_ensure_eol();
+        fprintf(stderr, "Fan speed set to %g in %.1f ms\n", speed, duration);
+    }
+    return duration;
+}
+
+struct cooldown_sample {
+    double time; // s
+    double temp; // °C
+    double slope; // °C/min
+    double fan;
+};
+
+// Cool-down progress stored in the CSV file
+vector<cooldown_sample> cooldown_trajectory;
+string cooldown_result;
+
+// Return sensors listed in comma-separated names (or all sensors).
+// NULL names means the first sensor.
+static vector<const sensor *> select_sensors(const char *names, const char *opt)
+{
+    vector<const sensor *> result;
+
+    if (state.sensors.empty())
+        errx(1, "%s: No sensors configured", opt);
+    if (!names) {
+        result.push_back(&state.sensors[0]);
+    } else if (strcmp(names, "all") == 0) {
+        for (const auto &s : state.sensors)
+            result.push_back(&s);
+    } else {
+        for (const auto &name : split(names, ",")) {
+            auto s = find_if(state.sensors.begin(), state.sensors.end(), [&](auto &s) { return s.name == name; });
+            if (s == state.sensors.end())
+                errx(1, "%s: Unknown sensor '%s'", opt, name.c_str());
+            result.push_back(&*s);
+        }
+    }
     return result;
 }
 
-void set_fan(char *fan_cmd, float speed)
+static vector<const sensor *> get_cooldown_sensors()
 {
-    char *cmd;
-    CHECK(asprintf(&cmd, "%s %g", fan_cmd, speed));
-    if (system(cmd) == -1)
-        err(1, "Error while executing shell command: %s\n", cmd);
-    free(cmd);
+    return select_sensors(cooldown_sensors, "--wait-sensors");
+}
+
+// Slope of linear regression of the samples in °C/min
+template <class Sample> static double regression_slope(const deque<Sample> &samples)
+{
+    if (samples.size() < 2)
+        return NAN;
+    double st = 0, sT = 0, stt = 0, stT = 0;
+    for (const auto &s : samples) {
+        st += s.time;
+        sT += s.temp;
+        stt += s.time * s.time;
+        stT += s.time * s.temp;
+    }
+    double n = samples.size();
+    double den = n * stt - st * st;
+    return den > 0 ? 60 * (n * stT - st * sT) / den : NAN;
 }
 
 void wait_cooldown(char *fan_cmd)
 {
-    if (fan_cmd)
-        set_fan(fan_cmd, 1);
+    const vector<const sensor *> sensors = get_cooldown_sensors();
+    const bool pid = fan_cmd && !isnan(cooldown_kp);
+    double fan = 1, fan_ms = NAN;
+    double integral = 0, prev_temp = NAN, prev_time = 0;
 
-    int time = 0;
+    if (fan_cmd && !pid)
+        fan_ms = set_fan(fan_cmd, fan);
+
+    deque<cooldown_sample> window; // Samples from the last cooldown_hold seconds
+    struct timespec start, next;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    next = start;
 
     while (1) {
-        double temp = read_sensor(state.sensors[0].path.c_str()) / 1000.0;
-        fprintf(stderr, "\rCooling down to %lg°C, current %s temperature: %lg°C, time: %ds...", cooldown_temp,
-                state.sensors[0].name.c_str(), temp, time);
-        if (temp <= cooldown_temp) {
+        double time = ms_since(start) / 1000.0;
+
+        // The hottest of the monitored sensors is controlled
+        double temp = NAN;
+        const sensor *hottest = sensors[0];
+        for (const sensor *s : sensors) {
+            double t = read_sensor(*s) / 1000.0;
+            if (isnan(temp) || t > temp) {
+                temp = t;
+                hottest = s;
+            }
+        }
+
+        window.push_back({ time, temp, NAN, NAN });
+        while (window.size() > 2 && window[1].time <= time - cooldown_hold)
+            window.pop_front();
+        double slope = regression_slope(window);
+
+        if (pid) {
+            // Derivative is calculated from measurement to avoid kicks
+            double dt = time - prev_time;
+            double e = temp - cooldown_temp;
+            double d = (isnan(prev_temp) || dt <= 0) ? 0 : (temp - prev_temp) / dt;
+            double u = cooldown_kp * e + cooldown_ki * (integral + e * dt) + cooldown_kd * d;
+            // Integrate only when not saturated (anti-windup)
+            if ((u > 0 && u < 1) || (u >= 1 && e < 0) || (u <= 0 && e > 0))
+                integral += e * dt;
+            u = fmin(fmax(u, 0), 1);
+            if (isnan(fan_ms) || fabs(u - fan) >= 0.01) {
+                fan = u;
+                fan_ms = set_fan(fan_cmd, fan, false);
+            }
+            prev_temp = temp;
+            prev_time = time;
+        }
+        cooldown_trajectory.push_back({ time, temp, slope, fan_cmd ? fan : NAN });
+
+        fprintf(stderr, "\rCooling down to %lg°C, current %s temperature: %lg°C", cooldown_temp,
+                hottest->name.c_str(), temp);
+        if (cooldown_stable)
+            fprintf(stderr, " (%+.2f°C/min)", slope);
+        if (pid)
+            fprintf(stderr, ", fan: %.2f (%.1f ms)", fan, fan_ms);
+        fprintf(stderr, ", time: %.1fs...", time);
+
+        bool done;
+        if (!cooldown_stable) {
+            done = temp <= cooldown_temp;
+        } else {
+            done = time - window.front().time >= cooldown_hold && fabs(slope) <= cooldown_slope
+                && all_of(window.begin(), window.end(),
+                          [](auto &s) { return s.temp <= cooldown_temp + cooldown_tolerance; });
+        }
+        if (done) {
             fprintf(stderr, "\nDone\n");
+            cooldown_result = "done";
             break;
         }
         if (time >= cooldown_timeout) {
             fprintf(stderr, "\nTimed out\n");
+            cooldown_result = "timeout";
             break;
         }
-        time += 2;
-        sleep(2);
+        next.tv_nsec += (long)cooldown_period_ms * 1000000;
+        next.tv_sec += next.tv_nsec / 1000000000;
+        next.tv_nsec %= 1000000000;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
     }
 
     if (fan_cmd && isnan(fan_on))
         set_fan(fan_cmd, 0);
 }
 
+// Write cool-down trajectory as CSV comments, so that the starting
+// state of different runs can be compared.
+static void write_cooldown_log(FILE *fp)
+{
+    if (cooldown_trajectory.empty())
+        return;
+
+    string names;
+    for (const sensor *s : get_cooldown_sensors())
+        names += (names.empty() ? "" : " ") + s->name;
+    fprintf(fp, "# Cool-down: target: %g°C, sensors: %s, result: %s, duration: %gs\n", cooldown_temp,
+            names.c_str(), cooldown_result.c_str(), cooldown_trajectory.back().time);
+    fprintf(fp, "# Cool-down trajectory: time/s,temp/°C,slope/°C/min,fan\n");
+    for (const auto &s : cooldown_trajectory)
+        fprintf(fp, "# %.3f,%g,%.3g,%g\n", s.time, s.temp, s.slope, s.fan);
+}
+
 void read_procstat()
 {
     FILE *fp = fopen("/proc/stat", "r");
@@ -478,12 +987,103 @@ double get_cpu_usage(struct cpu &cpu)
     return (idle + active) ? active / (active + idle) * 100 : 0;
 }
 
-void set_process_affinity(int pid, int cpu_id)
+// Start a process with vfork(). Unlike fork(), this does not copy
+// page tables of our address space, which makes the start faster.
+// Everything is set up in the child so that the attributes of
+// thermobench itself (e.g. CPU affinity) are never changed. If the
+// program cannot be executed, the child exits with status 127 like
+// the shell does. Returns after the program is executed.
+static pid_t spawn(char *const argv[], int stdout_fd, bool null_stdin, const cpu_set_t *cpus)
+{
+    sigset_t all, orig;
+    pid_t pid;
+    // The child must not use stdio while it shares our memory. It
+    // reports failures via this pipe, which is closed by exec.
+    int errpipe[2];
+    struct {
+        const char *what;
+        int err;
+    } failure = {};
+
+    CHECK(pipe2(errpipe, O_CLOEXEC));
+
+    // Don't let libev's signal handlers run in the child, which
+    // shares our memory until it calls exec.
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &orig);
+
+    pid = vfork();
+    if (pid == 0) {
+        struct sigaction dfl = {};
+        dfl.sa_handler = SIG_DFL;
+        for (int sig = 1; sig < NSIG; sig++)
+            sigaction(sig, &dfl, NULL);
+
+        // Run in background process group to not receive SIGINT from
+        // terminal and to be able to kill the process with its children.
+        setpgid(0, 0);
+        if (cpus && sched_setaffinity(0, sizeof(*cpus), cpus) == -1) {
+            failure = { "sched_setaffinity", errno };
+            goto fail;
+        }
+        if (null_stdin) {
+            int fd = open("/dev/null", O_RDONLY);
+            if (fd > STDIN_FILENO) {
+                dup2(fd, STDIN_FILENO);
+                close(fd);
+            }
+        }
+        dup2(stdout_fd, STDOUT_FILENO);
+        // Don't let the child inherit our signal mask, which libev
+        // "randomly" modifies.
+        sigemptyset(&all);
+        sigprocmask(SIG_SETMASK, &all, NULL);
+        execvp(argv[0], argv);
+        failure = { "exec", errno };
+    fail:
+        if (write(errpipe[1], &failure, sizeof(failure)) == -1) {
+            // Nothing more we can do
+        }
+        _exit(127);
+    }
+    pthread_sigmask(SIG_SETMASK, &orig, NULL);
+    close(errpipe[1]);
+    if (pid == -1)
+        err(1, "vfork");
+    if (read(errpipe[0], &failure, sizeof(failure)) == sizeof(failure)) {
+        errno = failure.err;
+        warn("%s(%s)", failure.what, argv[0]);
+    }
+    close(errpipe[0]);
+    return pid;
+}
+
+// Split cmd to words if it can be executed without the shell (see
+// --exec-direct), i.e. it contains no shell metacharacters.
+// Otherwise, return empty vector.
+static vector<string> split_simple_command(const string &cmd)
 {
-    cpu_set_t my_set;
-    CPU_ZERO(&my_set);
-    CPU_SET(cpu_id, &my_set);
-    sched_setaffinity(pid, sizeof(cpu_set_t), &my_set);
+    if (!exec_direct || cmd.find_first_of("|&;<>()$`\\\"'*?[]#~=%{}!\n") != string::npos)
+        return {};
+    return split_words(cmd);
+}
+
+// Parse CPU list such as "0-3,6"
+static void parse_cpu_list(const string &list, cpu_set_t &cpus, const char *opt)
+{
+    CPU_ZERO(&cpus);
+    for (const auto &range : split(list, ",")) {
+        char *end;
+        long first = strtol(range.c_str(), &end, 10), last = first;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+        if (end == range.c_str() || *end != 0 || first < 0 || last < first || last >= CPU_SETSIZE)
+            errx(1, "%s: Invalid CPU list: %s", opt, list.c_str());
+        for (long cpu = first; cpu <= last; cpu++)
+            CPU_SET(cpu, &cpus);
+    }
+    if (CPU_COUNT(&cpus) == 0)
+        errx(1, "%s: Empty CPU list", opt);
 }
 
 StdoutKeyColumn *get_stdout_key_column(const string_view key, vector<StdoutKeyColumn> &stdoutColumns)
@@ -511,6 +1111,535 @@ static double get_current_time()
 
 buffer_t child_stdout_buf;
 
+// Statistics of numeric columns in benchmark phases announced by
+// "@phase=NAME" lines (--phases)
+struct phase_tracker {
+    struct column_stats {
+        string header = {};
+        bool level = false; // Report only mean value (sensors), not rate of change
+        double sum = 0;
+        unsigned count = 0;
+        // Change of value (for rate calculation) in the current visit of the phase and in total
+        double first_t = NAN, first_v = NAN, last_t = NAN, last_v = NAN;
+        double delta_t = 0, delta_v = 0;
+    };
+    struct phase {
+        string name;
+        double duration = 0; // ms
+        map<unsigned, column_stats> columns = {}; // Indexed by column order
+    };
+    vector<phase> phases = {};
+    int current = -1;
+    double start = 0; // ms
+
+    void reset() { *this = phase_tracker(); }
+
+    const string current_name() const { return current >= 0 ? phases[current].name : ""; }
+
+    void leave(double time)
+    {
+        if (current < 0)
+            return;
+        phase &p = phases[current];
+        p.duration += time - start;
+        for (auto &[order, c] : p.columns) {
+            if (!isnan(c.first_t)) {
+                c.delta_t += c.last_t - c.first_t;
+                c.delta_v += c.last_v - c.first_v;
+            }
+            c.first_t = c.first_v = c.last_t = c.last_v = NAN;
+        }
+        current = -1;
+    }
+
+    void enter(const string &name, double time)
+    {
+        leave(time);
+        auto it = find_if(phases.begin(), phases.end(), [&](auto &p) { return p.name == name; });
+        if (it == phases.end())
+            it = phases.insert(phases.end(), phase { name });
+        current = it - phases.begin();
+        start = time;
+    }
+
+    void add(const CsvColumn &col, double time, double v, bool level)
+    {
+        if (current < 0)
+            return;
+        auto [it, inserted] = phases[current].columns.try_emplace(col.getOrder());
+        column_stats &c = it->second;
+        if (inserted) {
+            c.header = col.getHeader();
+            c.level = level;
+        }
+        c.sum += v;
+        c.count++;
+        if (isnan(c.first_t)) {
+            c.first_t = time;
+            c.first_v = v;
+        }
+        c.last_t = time;
+        c.last_v = v;
+    }
+
+    void write(FILE *fp) const
+    {
+        for (const auto &p : phases) {
+            fprintf(fp, "# Phase %s: duration: %.3f s", p.name.c_str(), p.duration / 1000);
+            for (const auto &[order, c] : p.columns) {
+                fprintf(fp, ", %s: %g", c.header.c_str(), c.sum / c.count);
+                if (!c.level && c.delta_t > 0)
+                    fprintf(fp, " (%g/s)", c.delta_v / c.delta_t * 1000);
+            }
+            fprintf(fp, "\n");
+        }
+    }
+} phases;
+
+// Summary statistics of all numeric columns (--stats)
+struct column_summary {
+    string header;
+    bool level; // Do not report rate of change (sensors)
+    ColumnStats stats;
+};
+map<unsigned, column_summary> summaries; // Indexed by column order
+
+// Feed numeric value stored in a CSV column to the statistics
+static void record_value(const CsvColumn &col, double time, const string &value, bool level = false)
+{
+    if (!stats_enabled && !metrics_addr && !track_phases)
+        return;
+    char *end;
+    double v = strtod(value.c_str(), &end);
+    if (end == value.c_str() || isnan(v))
+        return;
+    phases.add(col, time, v, level);
+    if (stats_enabled || metrics_addr) {
+        auto [it, inserted] = summaries.try_emplace(col.getOrder(), column_summary { col.getHeader(), level, {} });
+        it->second.stats.add(time, v);
+    }
+}
+
+static void write_stats(FILE *fp)
+{
+    for (auto &[order, s] : summaries) {
+        ColumnStats &c = s.stats;
+        fprintf(fp, "# Stats %s: count: %lu, mean: %g, stddev: %g, min: %g, max: %g, p50: %g, p90: %g, p99: %g",
+                s.header.c_str(), c.count(), c.mean(), c.stddev(), c.min(), c.max(), c.quantile(0.5),
+                c.quantile(0.9), c.quantile(0.99));
+        if (!s.level && !isnan(c.rate()))
+            fprintf(fp, ", rate: %g/s", c.rate());
+        fprintf(fp, "\n");
+    }
+}
+
+static string json_string(const string &str)
+{
+    string res = "\"";
+    for (unsigned char ch : str) {
+        if (ch == '"' || ch == '\\') {
+            res += '\\';
+            res += ch;
+        } else if (ch < 0x20) {
+            char esc[7];
+            snprintf(esc, sizeof(esc), "\\u%04x", ch);
+            res += esc;
+        } else {
+            res += ch;
+        }
+    }
+    return res + "\"";
+}
+
+static string json_number(double x)
+{
+    if (!isfinite(x))
+        return "null";
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.10g", x);
+    return buf;
+}
+
+// Write statistics to a JSON file next to the CSV file
+static void write_stats_json(const string &csv_file)
+{
+    string file = csv_file;
+    if (file.size() > 4 && file.compare(file.size() - 4, 4, ".csv") == 0)
+        file.erase(file.size() - 4);
+    file += ".json";
+
+    FILE *fp = fopen(file.c_str(), "w");
+    if (!fp)
+        err(1, "open(%s)", file.c_str());
+    fprintf(fp, "{\n  \"csv\": %s,\n  \"columns\": {", json_string(csv_file).c_str());
+    const char *sep = "\n";
+    for (auto &[order, s] : summaries) {
+        ColumnStats &c = s.stats;
+        fprintf(fp, "%s    %s: { \"count\": %lu, \"mean\": %s, \"stddev\": %s, \"min\": %s, \"max\": %s, "
+                "\"p50\": %s, \"p90\": %s, \"p99\": %s, \"rate\": %s }",
+                sep, json_string(s.header).c_str(), c.count(), json_number(c.mean()).c_str(),
+                json_number(c.stddev()).c_str(), json_number(c.min()).c_str(), json_number(c.max()).c_str(),
+                json_number(c.quantile(0.5)).c_str(), json_number(c.quantile(0.9)).c_str(),
+                json_number(c.quantile(0.99)).c_str(), json_number(s.level ? NAN : c.rate()).c_str());
+        sep = ",\n";
+    }
+    fprintf(fp, "\n  }\n}\n");
+    if (fclose(fp) != 0)
+        err(1, "write(%s)", file.c_str());
+}
+
+// Serves the latest sample and statistics in Prometheus text format
+// (--metrics). The server runs in a separate thread; the event loop
+// only publishes a snapshot after each sample and never waits for the
+// server.
+class MetricsServer {
+    struct column {
+        string header;
+        bool level;
+        double last, mean, stddev, min, max, rate;
+        unsigned long count;
+    };
+    struct snapshot {
+        vector<column> columns = {};
+        double time = NAN; // s
+        unsigned long samples = 0;
+    };
+
+    mutex lock = {};
+    snapshot published = {};
+    unsigned long samples = 0;
+    int listen_fd = -1;
+    string socket_path = {}; // Unix socket to remove at exit
+
+    static string label(const string &value);
+    string format();
+    void serve();
+
+public:
+    void start(const char *addr);
+    void update(double time);
+} metrics;
+
+string MetricsServer::label(const string &value)
+{
+    string res;
+    for (char ch : value) {
+        if (ch == '\\' || ch == '"')
+            res += '\\', res += ch;
+        else if (ch == '\n')
+            res += "\\n";
+        else
+            res += ch;
+    }
+    return res;
+}
+
+void MetricsServer::update(double time)
+{
+    samples++;
+    // Skip the update rather than wait for the server thread
+    unique_lock<mutex> guard(lock, try_to_lock);
+    if (!guard.owns_lock())
+        return;
+    published.time = time / 1000;
+    published.samples = samples;
+    published.columns.clear();
+    for (auto &[order, s] : summaries) {
+        const ColumnStats &c = s.stats;
+        published.columns.push_back(
+            { s.header, s.level, c.last(), c.mean(), c.stddev(), c.min(), c.max(), c.rate(), c.count() });
+    }
+}
+
+string MetricsServer::format()
+{
+    snapshot snap;
+    {
+        lock_guard<mutex> guard(lock);
+        snap = published;
+    }
+
+    stringstream out;
+    auto metric = [&](const char *name, const char *type, const char *help, auto value) {
+        out << "# HELP thermobench_" << name << " " << help << "\n";
+        out << "# TYPE thermobench_" << name << " " << type << "\n";
+        for (const auto &c : snap.columns) {
+            double v = value(c);
+            if (!isnan(v))
+                out << "thermobench_" << name << "{column=\"" << label(c.header) << "\"} " << json_number(v) << "\n";
+        }
+    };
+    out << "# HELP thermobench_time_seconds Time of the last sample relative to benchmark start\n"
+        << "# TYPE thermobench_time_seconds gauge\n"
+        << "thermobench_time_seconds " << (isnan(snap.time) ? "NaN" : json_number(snap.time)) << "\n"
+        << "# HELP thermobench_samples_total Number of samples taken\n"
+        << "# TYPE thermobench_samples_total counter\n"
+        << "thermobench_samples_total " << snap.samples << "\n";
+    metric("value", "gauge", "Last value of CSV column", [](auto &c) { return c.last; });
+    metric("values_total", "counter", "Number of values in CSV column", [](auto &c) { return (double)c.count; });
+    metric("mean", "gauge", "Mean value of CSV column", [](auto &c) { return c.mean; });
+    metric("stddev", "gauge", "Standard deviation of CSV column", [](auto &c) { return c.stddev; });
+    metric("min", "gauge", "Minimum value of CSV column", [](auto &c) { return c.min; });
+    metric("max", "gauge", "Maximum value of CSV column", [](auto &c) { return c.max; });
+    metric("rate", "gauge", "Rate of increase of counter in CSV column [1/s]",
+           [](auto &c) { return c.level ? NAN : c.rate; });
+    return out.str();
+}
+
+void MetricsServer::serve()
+{
+    while (true) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            // E.g. out of file descriptors. Don't spin and heat up
+            // the CPUs under test.
+            warn("--metrics: accept");
+            sleep(1);
+            continue;
+        }
+        // Read (and ignore) the request. Any request gets the metrics.
+        struct timeval tv = { 1, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        string req;
+        char buf[1024];
+        ssize_t ret;
+        while (req.find("\r\n\r\n") == string::npos && req.find("\n\n") == string::npos
+               && (ret = read(fd, buf, sizeof(buf))) > 0)
+            req.append(buf, ret);
+
+        string body = format();
+        string resp = "HTTP/1.0 200 OK\r\n"
+                      "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                      "Content-Length: "
+            + to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        for (size_t done = 0; done < resp.size() && (ret = send(fd, resp.data() + done, resp.size() - done, MSG_NOSIGNAL)) > 0;)
+            done += ret;
+        close(fd);
+    }
+}
+
+void MetricsServer::start(const char *addr)
+{
+    string a(addr);
+
+    if (a.find('/') != string::npos) {
+        struct sockaddr_un sa = {};
+        sa.sun_family = AF_UNIX;
+        if (a.size() >= sizeof(sa.sun_path))
+            errx(1, "--metrics: Socket path too long: %s", addr);
+        strcpy(sa.sun_path, addr);
+        // Replace a stale socket from a previous run, but nothing else
+        struct stat st;
+        if (lstat(addr, &st) == 0) {
+            if (!S_ISSOCK(st.st_mode))
+                errx(1, "--metrics: %s exists and is not a socket", addr);
+            unlink(addr);
+        }
+        listen_fd = CHECK(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if (bind(listen_fd, (struct sockaddr *)&sa, sizeof(sa)) == -1)
+            err(1, "--metrics: bind(%s)", addr);
+        socket_path = a;
+        atexit([] { unlink(metrics.socket_path.c_str()); });
+    } else {
+        // [HOST:]PORT, HOST defaults to localhost
+        size_t colon = a.rfind(':');
+        string host = colon == string::npos ? "localhost" : a.substr(0, colon);
+        string port = colon == string::npos ? a : a.substr(colon + 1);
+        if (host.size() > 2 && host.front() == '[' && host.back() == ']')
+            host = host.substr(1, host.size() - 2);
+
+        struct addrinfo hints = {}, *res;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        int ret = getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &res);
+        if (ret != 0)
+            errx(1, "--metrics: %s: %s", addr, gai_strerror(ret));
+        listen_fd = CHECK(socket(res->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        int one = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(listen_fd, res->ai_addr, res->ai_addrlen) == -1)
+            err(1, "--metrics: bind(%s)", addr);
+        freeaddrinfo(res);
+    }
+    CHECK(listen(listen_fd, 8));
+
+    // Signals are handled by the event loop in the main thread
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    thread([this] { serve(); }).detach();
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+// Flight recorder (--recorder): Only every decimation-th sample is
+// written to the CSV file, but all rows from the last window are kept in
+// memory. When a trigger fires, they are written to a separate file
+// together with the rows from the following window. Triggers firing
+// during a dump extend it by another window.
+struct flight_recorder {
+    struct trigger {
+        string spec;
+        const CsvColumn *column;
+        enum { ANY, CHANGE, ABOVE, BELOW } type;
+        double threshold;
+        string last = {}; // Last value (CHANGE)
+        bool active = false; // Condition was true in the last value (ABOVE, BELOW)
+
+        // Returns true when the trigger fires
+        bool check(const string &value)
+        {
+            switch (type) {
+            case ANY:
+                return true;
+            case CHANGE: {
+                bool changed = !last.empty() && value != last;
+                last = value;
+                return changed;
+            }
+            case ABOVE:
+            case BELOW: {
+                char *end;
+                double v = strtod(value.c_str(), &end);
+                if (end == value.c_str())
+                    return false;
+                bool was_active = active;
+                active = type == ABOVE ? v > threshold : v < threshold;
+                return active && !was_active;
+            }
+            }
+            return false;
+        }
+    };
+
+    double window = 0; // ms, zero means disabled
+    unsigned decimation = 10;
+    vector<trigger> triggers = {};
+    deque<pair<double, string>> ring = {}; // time, CSV line
+    unsigned long samples = 0;
+    unsigned dumps = 0;
+    unsigned fired = 0; // Including triggers that extended a dump
+    FILE *dump_fp = nullptr;
+    string dump_file = {};
+    double dump_until = NAN;
+
+    void init()
+    {
+        triggers.clear();
+        for (const string &spec : trigger_specs) {
+            trigger t { spec, nullptr, trigger::ANY, NAN };
+            string col = spec;
+            size_t pos = spec.find_last_of("<>");
+            if (!spec.empty() && spec.back() == '~') {
+                t.type = trigger::CHANGE;
+                col = spec.substr(0, spec.size() - 1);
+            } else if (pos != string::npos) {
+                char *end;
+                t.type = spec[pos] == '>' ? trigger::ABOVE : trigger::BELOW;
+                t.threshold = strtod(spec.c_str() + pos + 1, &end);
+                if (end == spec.c_str() + pos + 1 || *end)
+                    errx(1, "--trigger: Invalid threshold in: %s", spec.c_str());
+                col = spec.substr(0, pos);
+            }
+            if (!(t.column = columns.find(col)))
+                errx(1, "--trigger: Unknown column '%s'", col.c_str());
+            triggers.push_back(t);
+        }
+        ring.clear();
+        samples = dumps = fired = 0;
+        dump_until = NAN;
+    }
+
+    // Returns whether a sample row should be written to the CSV file
+    bool decimate() { return samples++ % decimation == 0; }
+
+    void start_dump(double time, const string &spec)
+    {
+        string file = out_file;
+        if (file == "-")
+            file = "thermobench";
+        else if (file.size() > 4 && file.compare(file.size() - 4, 4, ".csv") == 0)
+            file.erase(file.size() - 4);
+        file += "-trigger" + to_string(++dumps) + ".csv";
+        dump_file = file;
+
+        verbose_ensure_eol();
+        fprintf(stderr, "Trigger %s fired at %.3f s, writing %s\n", spec.c_str(), time / 1000, file.c_str());
+        dump_fp = fopen(file.c_str(), "w");
+        if (!dump_fp)
+            err(1, "open(%s)", file.c_str());
+        fprintf(dump_fp, "# Trigger: %s at %.3f s\n", spec.c_str(), time / 1000);
+        CsvRow header(columns);
+        columns.setHeader(header);
+        header.write(dump_fp);
+        for (const auto &r : ring)
+            fputs(r.second.c_str(), dump_fp);
+        ring.clear();
+        dump_until = time + window;
+    }
+
+    void extend_dump(double time, const string &spec)
+    {
+        verbose_ensure_eol();
+        fprintf(stderr, "Trigger %s fired at %.3f s, extending %s\n", spec.c_str(), time / 1000, dump_file.c_str());
+        fprintf(dump_fp, "# Trigger: %s at %.3f s\n", spec.c_str(), time / 1000);
+        dump_until = time + window;
+    }
+
+    void stop_dump()
+    {
+        if (!dump_fp)
+            return;
+        fclose(dump_fp);
+        dump_fp = nullptr;
+        dump_until = NAN;
+    }
+
+    void record(const CsvRow &row)
+    {
+        double time = atof(row.getValue(time_column).c_str());
+        string line = row.toString();
+
+        const trigger *trig = nullptr;
+        for (auto &t : triggers) {
+            string value = row.getValue(*t.column);
+            if (!value.empty() && t.check(value) && !trig)
+                trig = &t;
+        }
+        if (trig)
+            fired++;
+
+        if (dump_fp) {
+            if (trig)
+                extend_dump(time, trig->spec);
+            fputs(line.c_str(), dump_fp);
+            if (time >= dump_until)
+                stop_dump();
+            return;
+        }
+
+        ring.emplace_back(time, move(line));
+        while (ring.front().first < time - window)
+            ring.pop_front();
+        if (trig)
+            start_dump(time, trig->spec);
+    }
+} recorder;
+
+// Write a data row to the CSV file. sample is true for rows written
+// periodically by measure_timer_cb.
+static void output_row(CsvRow &row, bool sample = false)
+{
+    if (!recorder.window) {
+        row.write(state.out_fp);
+        return;
+    }
+    if (!sample || recorder.decimate())
+        row.write(state.out_fp);
+    recorder.record(row);
+}
+
 static void child_stdout_cb(ev::io &w, int revents)
 {
     buffer_t &buf = child_stdout_buf;
@@ -532,6 +1661,19 @@ static void child_stdout_cb(ev::io &w, int revents)
     while ((eol = find(buf.begin(), buf.end(), '\n')) != buf.end()) {
         buffer_t::iterator eq = find(buf.begin(), eol, '=');
         const CsvColumn *col = nullptr;
+        if (track_phases && eq != eol && string_view(&(*buf.begin()), distance(buf.begin(), eq)) == "@phase") {
+            if (!row.empty())
+                output_row(row);
+            row.clear();
+            string name(&(*(eq + 1)), distance(eq + 1, eol));
+            phases.enter(name, curr_time);
+            row.set(time_column, curr_time);
+            row.set(*phase_column, name);
+            output_row(row);
+            row.clear();
+            buf.erase(buf.begin(), eol + 1);
+            continue;
+        }
         if (eq != eol) {
             const string_view key(&(*buf.begin()), distance(buf.begin(), eq));
             col = get_stdout_column(key, state.stdoutColumns);
@@ -540,128 +1682,384 @@ static void child_stdout_cb(ev::io &w, int revents)
             if (row.empty())
                 row.set(time_column, curr_time);
             if (!row.getValue(*col).empty()) {
-                row.write(state.out_fp);
+                output_row(row);
                 row.clear();
                 row.set(time_column, curr_time);
             }
-            const string_view value(&(*(eq + 1)), distance(eq + 1, eol));
-            row.set(*col, string(value));
+            const string value(&(*(eq + 1)), distance(eq + 1, eol));
+            row.set(*col, value);
+            record_value(*col, curr_time, value);
         } else if (write_stdout) {
             string line(&(*buf.begin()), distance(buf.begin(), eol));
             row.set(time_column, curr_time);
             row.set(*stdout_column, line);
-            row.write(state.out_fp);
+            output_row(row);
             row.clear();
         }
         buf.erase(buf.begin(), eol + 1);
     }
 
     if (!row.empty())
-        row.write(state.out_fp);
+        output_row(row);
+    if (csv_unbuffered)
+        fflush(state.out_fp);
+}
+
+void LineSource::start_reading(ev::loop_ref loop, int fd)
+{
+    input.set(loop);
+    input.set<LineSource, &LineSource::input_cb>(this);
+    input.start(fd, ev::READ);
+
+    buf.reset(new __gnu_cxx::stdio_filebuf<char>(fd, ios::in));
+}
+
+void LineSource::stop_reading()
+{
+    input.stop();
+    buf.reset(); // Closes the file descriptor
+}
+
+void LineSource::input_cb(ev::io &w, int revents)
+{
+    istream pipe_in(buf.get());
+    string line;
+    double curr_time = get_current_time();
+    CsvRow row(::columns);
+    auto store_value = [&](StdoutKeyColumn &column, string value) {
+        if (column.synchronous) {
+            column.add_value(move(value));
+        } else {
+            if (row.empty())
+                row.set(time_column, curr_time);
+
+            if (!row.getValue(column.column).empty()) {
+                output_row(row);
+                row.clear();
+                row.set(time_column, curr_time);
+            }
+            row.set(column.column, value);
+            record_value(column.column, curr_time, value);
+        }
+    };
+    while (getline(pipe_in, line)) {
+        line.erase(line.find_last_not_of("\r\n") + 1);
+        size_t index = line.find_first_of('=');
+        bool matched = false;
+
+        if (index != string::npos) {
+            // The same key can be stored in multiple columns with
+            // different aggregations
+            const string_view key(line.data(), index);
+            for (auto &column : this->columns) {
+                if (!column.key.empty() && column.key == key) {
+                    store_value(column, line.substr(index + 1));
+                    matched = true;
+                }
+            }
+        }
+
+        if (!matched && this->stdout_col)
+            store_value(*this->stdout_col, move(line));
+    }
+
+    if (!row.empty())
+        output_row(row);
+
     if (csv_unbuffered)
         fflush(state.out_fp);
+
+    if (pipe_in.eof())
+        input_eof();
+}
+
+void Process::watch(ev::loop_ref loop, pid_t pid)
+{
+    pidfd = syscall(SYS_pidfd_open, pid, 0);
+    if (pidfd == -1)
+        err(1, "pidfd_open");
+    this->pid = pid;
+    status = 0;
+    term_sent = false;
+    tracked_pids.insert(pid);
+
+    // pidfd becomes readable when the process terminates
+    exit_watcher.set(loop);
+    exit_watcher.set<Process, &Process::exit_cb>(this);
+    exit_watcher.start(pidfd, ev::READ);
+    kill_timer.set(loop);
+    kill_timer.set<Process, &Process::kill_cb>(this);
+}
+
+void Process::signal(int sig)
+{
+    // The process (zombie) is not reaped yet so its process group
+    // cannot be reused by somebody else.
+    syscall(SYS_pidfd_send_signal, pidfd, sig, NULL, 0);
+    ::kill(-pid, sig);
+}
+
+void Process::terminate()
+{
+    if (!running() || term_sent)
+        return;
+    signal(SIGTERM);
+    term_sent = true;
+    if (kill_timeout > 0)
+        kill_timer.start(kill_timeout);
+}
+
+void Process::kill_cb(ev::timer &w, int revents)
+{
+    verbose_ensure_eol();
+    warnx("Process %d did not terminate in %gs, sending SIGKILL", pid, kill_timeout);
+    signal(SIGKILL);
+}
+
+void Process::exit_cb(ev::io &w, int revents)
+{
+    if (wait4(pid, &status, WNOHANG, &usage) != pid)
+        return;
+    exit_watcher.stop();
+    kill_timer.stop();
+    close(pidfd);
+    pidfd = -1;
+    tracked_pids.erase(pid);
+    pid = 0;
+    if (on_exit)
+        on_exit();
+}
+
+// Returns children that are not tracked, i.e. descendants of the
+// benchmarks reparented to us because we are a subreaper.
+static vector<pid_t> find_orphans()
+{
+    vector<pid_t> result;
+    DIR *dir = opendir("/proc");
+    if (!dir)
+        return result;
+    while (struct dirent *de = readdir(dir)) {
+        pid_t pid = atoi(de->d_name);
+        if (pid <= 0 || tracked_pids.count(pid) || pid == fan_pid)
+            continue;
+        string stat = areadfileline(("/proc/" + string(de->d_name) + "/stat").c_str());
+        // The ppid is the second field after the parenthesized command name
+        size_t paren = stat.rfind(')');
+        int ppid;
+        if (paren != string::npos && sscanf(stat.c_str() + paren + 1, " %*c %d", &ppid) == 1 && ppid == getpid())
+            result.push_back(pid);
+    }
+    closedir(dir);
+    return result;
+}
+
+// Kill processes that escaped from the benchmark process group, e.g.
+// daemons, and reap them.
+static void kill_orphans()
+{
+    auto reaped = [](pid_t pid) { return waitpid(pid, NULL, WNOHANG) == pid; };
+    vector<pid_t> orphans = find_orphans();
+    orphans.erase(remove_if(orphans.begin(), orphans.end(), reaped), orphans.end());
+    if (orphans.empty())
+        return;
+    verbose_ensure_eol();
+    fprintf(stderr, "Terminating %zu process(es) left behind by the benchmark\n", orphans.size());
+    for (pid_t pid : orphans)
+        kill(pid, SIGTERM);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (!orphans.empty()) {
+        if (ms_since(start) >= kill_timeout * 1000)
+            for (pid_t pid : orphans)
+                kill(pid, SIGKILL);
+        usleep(10000);
+        orphans.erase(remove_if(orphans.begin(), orphans.end(), reaped), orphans.end());
+    }
 }
 
 void Exec::start(ev::loop_ref loop)
 {
     int pipefds[2];
 
-    CHECK(pipe2(pipefds, O_NONBLOCK));
+    CHECK(pipe2(pipefds, O_NONBLOCK | O_CLOEXEC));
 
-    pid = CHECK(vfork());
+    // With --exec-direct, simple commands are executed without the shell
+    vector<string> words = split_simple_command(cmd);
+    if (words.empty())
+        words = { "/bin/sh", "-c", cmd };
+    vector<char *> argv;
+    for (auto &w : words)
+        argv.push_back(w.data());
+    argv.push_back(nullptr);
 
-    if (pid == 0) {
-        // Child
-        setpgid(0, 0); // Run in background process group to not receive SIGINT from terminal
-        close(pipefds[0]);
-        CHECK(dup2(CHECK(open("/dev/null", O_RDONLY)), STDIN_FILENO));
-        CHECK(dup2(pipefds[1], STDOUT_FILENO));
-        CHECK(execl("/bin/sh", "/bin/sh", "-c", cmd.c_str(), NULL));
-    }
+    pid_t pid = spawn(argv.data(), pipefds[1], true, has_affinity ? &affinity : nullptr);
 
     close(pipefds[1]);
 
-    child.set(loop);
-    child.set<Exec, &Exec::child_exit_cb>(this);
-    child.start(pid);
+    proc.on_exit = [this]() { child_exit_cb(); };
+    proc.watch(loop, pid);
 
-    child_stdout.set(loop);
-    child_stdout.set<Exec, &Exec::child_stdout_cb>(this);
-    child_stdout.start(pipefds[0], ev::READ);
+    // When the pipe is closed, the watcher is stopped (input_eof). If
+    // this was the last watcher, the event loop terminates.
+    start_reading(loop, pipefds[0]);
+}
 
-    buf.reset(new __gnu_cxx::stdio_filebuf<char>(pipefds[0], ios::in));
+void Exec::kill()
+{
+    if (!exec_wait)
+        proc.terminate();
+}
+
+Corun::Corun(const string &name, const string &cmd, const cpu_set_t *cpus)
+    : Exec(make_columns(name), cmd)
+    , name(name)
+{
+    if (cpus) {
+        has_affinity = true;
+        affinity = *cpus;
+    }
+}
+
+// Columns for all values of COMMAND (-c, -l) prefixed by the co-run name
+vector<StdoutKeyColumn> Corun::make_columns(const string &name)
+{
+    vector<StdoutKeyColumn> cols;
+    for (const auto &c : state.stdoutColumns)
+        cols.push_back(StdoutKeyColumn(name + "_" + c.key, c.key, false));
+    if (write_stdout)
+        cols.push_back(StdoutKeyColumn(name + "_stdout", "", false));
+    return cols;
+}
+
+// Parses [NAME][@CPUS]:CMD or CMD
+Corun *Corun::parse(const string &arg)
+{
+    static const regex re(R"(([A-Za-z0-9_.-]*)(@([0-9,-]+))?:(.*))");
+    smatch m;
+    string name, cmd = arg;
+    cpu_set_t cpus;
+    bool has_cpus = false;
+
+    if (regex_match(arg, m, re)) {
+        name = m[1];
+        cmd = m[4];
+        if (m[3].matched) {
+            parse_cpu_list(m[3], cpus, "--corun");
+            has_cpus = true;
+        }
+    }
+    cmd.erase(0, cmd.find_first_not_of(" \t"));
+    if (cmd.empty())
+        errx(1, "--corun: No command");
+    if (name.empty()) {
+        name = first_word(cmd);
+        name.erase(0, name.find_last_of('/') + 1);
+    }
+    return new Corun(name, cmd, has_cpus ? &cpus : nullptr);
 }
 
-void Exec::kill()
+void Corun::start(ev::loop_ref loop)
 {
-    if (pid > 0 && !exec_wait) {
-        ::kill(-pid, SIGTERM);
-    }
+    if (verbose)
+        fprintf(stderr, "Running %s: %s\n", name.c_str(), cmd.c_str());
+    Exec::start(loop);
 }
 
-void Exec::child_stdout_cb(ev::io &w, int revents)
+void Corun::kill()
 {
-    istream pipe_in(buf.get());
-    string line;
-    double curr_time = get_current_time();
-    CsvRow row(::columns);
-    while (getline(pipe_in, line)) {
-        line.erase(line.find_last_not_of("\r\n") + 1);
-        size_t index = line.find_first_of('=');
-        StdoutKeyColumn *column = nullptr;
+    // Unlike --exec, co-runs always terminate with COMMAND
+    proc.terminate();
+}
 
-        if (index != string::npos)
-            column = get_stdout_key_column((line.substr(0, index)).c_str(), this->columns);
+void Exec::child_exit_cb()
+{
+    int s = proc.status;
+    if (WIFEXITED(s) && WEXITSTATUS(s) != 0)
+        fprintf(stderr, "Command '%s' exited with status %d\n", cmd.c_str(), WEXITSTATUS(s));
+}
 
-        if (column)
-            line = line.substr(index + 1);
-        else
-            column = this->stdout_col;
+#define INPUT_RECONNECT_DELAY 1.0 // seconds
 
-        if (column) {
-            if (column->synchronous) {
-                column->last_value = move(line);
-            } else {
-                if (row.empty())
-                    row.set(time_column, curr_time);
+void Input::start(ev::loop_ref loop)
+{
+    input.set(loop);
+    reconnect.set(loop);
+    reconnect.set<Input, &Input::reconnect_cb>(this);
+    connect();
+}
 
-                if (!row.getValue(column->column).empty()) {
-                    row.write(state.out_fp);
-                    row.clear();
-                    row.set(time_column, curr_time);
-                }
-                row.set(column->column, line.c_str());
-            }
+void Input::connect()
+{
+    struct stat st;
+    int fd = -1;
+
+    if (stat(path.c_str(), &st) == -1) {
+        // Socket may not exist (yet)
+    } else if (S_ISFIFO(st.st_mode)) {
+        // Open for writing too. This way we never see EOF when
+        // writers come and go.
+        fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    } else if (S_ISSOCK(st.st_mode)) {
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path))
+            errx(1, "--input: Socket path too long: %s", path.c_str());
+        strcpy(addr.sun_path, path.c_str());
+
+        fd = CHECK(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if (::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+            close(fd);
+            fd = -1;
+        } else {
+            CHECK(fcntl(fd, F_SETFL, CHECK(fcntl(fd, F_GETFL)) | O_NONBLOCK));
         }
+    } else {
+        errx(1, "--input: %s is neither a socket nor a named pipe", path.c_str());
     }
 
-    if (!row.empty())
-        row.write(state.out_fp);
+    if (fd == -1) {
+        if (!warned) {
+            verbose_ensure_eol();
+            warn("--input: Cannot open %s, retrying every %gs", path.c_str(), INPUT_RECONNECT_DELAY);
+            warned = true;
+        }
+        reconnect.start(INPUT_RECONNECT_DELAY);
+        return;
+    }
 
-    if (csv_unbuffered)
-        fflush(state.out_fp);
+    if (warned && verbose) {
+        verbose_ensure_eol();
+        fprintf(stderr, "Connected to %s\n", path.c_str());
+    }
+    warned = false;
+    start_reading(input.loop, fd);
+}
 
-    // Stop the watcher if the pipe is closed. If this was the last
-    // watcher, the event loop terminates.
-    if (pipe_in.eof())
-        w.stop();
+void Input::reconnect_cb(ev::timer &w, int revents)
+{
+    connect();
 }
 
-void Exec::child_exit_cb(ev::child &w, int revents)
+void Input::input_eof()
 {
-    int s = w.rstatus;
-    if (WIFEXITED(s) && WEXITSTATUS(s) != 0)
-        fprintf(stderr, "Command '%s' exited with status %d\n", cmd.c_str(), WEXITSTATUS(s));
-    w.stop();
-    pid = 0;
+    // The peer closed the connection - try to reconnect
+    stop_reading();
+    verbose_ensure_eol();
+    warnx("--input: Connection to %s closed, reconnecting", path.c_str());
+    warned = true;
+    reconnect.start(INPUT_RECONNECT_DELAY);
 }
 
-static void child_exit_cb(EV_P_ ev_child *w, int revents)
+void Input::kill()
 {
-    // Stop all child-related watchers. If no watches remain started,
-    // the event loop exits.
-    ev_child_stop(EV_A_ w);
+    reconnect.stop();
+    if (buf)
+        stop_reading();
+}
 
+static void child_exit_cb(EV_P)
+{
     // Stop other watchers that my block event loop from exiting.
     ev_timer_stop(EV_A_ & measure_timer);
     ev_timer_stop(EV_A_ & randomized_timer);
@@ -669,39 +2067,229 @@ static void child_exit_cb(EV_P_ ev_child *w, int revents)
     ev_signal_stop(EV_A_ & sigint_watcher);
     ev_signal_stop(EV_A_ & sigterm_watcher);
 
+    phases.leave(get_current_time());
+
     // Also kill other processes - if there are any, event loop exits
     // after all terminate.
-    for (const auto &exec : state.execs)
-        exec->kill();
+    for (const auto &source : state.sources)
+        source->kill();
+
+    // Terminate processes that escaped from the benchmark process
+    // group. They might keep its stdout open.
+    for (pid_t pid : find_orphans())
+        kill(pid, SIGTERM);
 
     // Now, we wait for children stdout pipes to be closed. After all
     // are closed, our event loop exits.
 }
 
-static void measure_timer_cb(EV_P_ ev_timer *w, int revents)
+static void terminate_timer_cb(EV_P_ ev_timer *w, int revents);
+
+// Detects when the temperatures stop changing, i.e. linear regression
+// of each selected sensor over the last steady_window seconds has slope
+// within ±steady_slope.
+struct steady_state_detector {
+    struct sample {
+        double time; // s
+        double temp; // °C
+    };
+    vector<unsigned> sensors = {}; // Indices to state.sensors
+    vector<deque<sample>> windows = {};
+    double reached = NAN; // Time [s] when steady state was detected
+    double max_slope = NAN; // Worst slope at that time [°C/min]
+
+    void init()
+    {
+        for (const sensor *s : select_sensors(steady_sensors, "--steady-sensors"))
+            sensors.push_back(s - &state.sensors[0]);
+        windows.resize(sensors.size());
+    }
+
+    // Returns true when steady state is reached for the first time
+    bool update(double time, const vector<double> &values)
+    {
+        if (!isnan(reached))
+            return false;
+
+        double worst = 0;
+        bool steady = true;
+        for (unsigned i = 0; i < sensors.size(); i++) {
+            auto &w = windows[i];
+            w.push_back({ time, values[sensors[i]] / 1000.0 });
+            while (w.size() > 2 && w[1].time <= time - steady_window)
+                w.pop_front();
+            double slope = regression_slope(w);
+            if (time - w.front().time < steady_window || !(fabs(slope) <= steady_slope))
+                steady = false;
+            worst = fmax(worst, fabs(slope));
+        }
+        if (steady) {
+            reached = time;
+            max_slope = worst;
+        }
+        return steady;
+    }
+} steady_state;
+
+// Online fitting of the thermal model T(t) = T∞ + k·e^(-t/τ) (the
+// first-order variant of the model from julia/src/Thermobench.jl).
+// For a fixed τ, the model is linear in T∞ and k, so we search only
+// for τ (variable projection) and solve for T∞ and k with least
+// squares. To bound the fitting time, samples are decimated by
+// a factor of two whenever the history buffer becomes full.
+struct thermal_model_fit {
+    static constexpr unsigned max_samples = 512;
+    static constexpr double tau_min = 1, tau_max = 60 * 60; // s
+
+    unsigned sensor; // Index to state.sensors
+    vector<pair<double, double>> samples = {}; // time [s], temperature [°C]
+    unsigned decimation = 1, counter = 0;
+
+    double Tinf = NAN, k = NAN, tau = NAN; // Model coefficients
+    double Tinf_err = NAN; // Standard error of T∞
+    double rmse = NAN;
+
+    thermal_model_fit(unsigned sensor)
+        : sensor(sensor)
+    {
+    }
+
+    void add(double time, double temp)
+    {
+        if (counter++ % decimation != 0)
+            return;
+        samples.push_back({ time, temp });
+        if (samples.size() >= max_samples) {
+            for (unsigned i = 0; i < samples.size() / 2; i++)
+                samples[i] = samples[2 * i];
+            samples.resize(samples.size() / 2);
+            decimation *= 2;
+        }
+        if (samples.size() >= 4)
+            update();
+    }
+
+    // Least squares for T∞ and k with fixed τ. Returns residual sum of squares.
+    double solve_linear(double tau, double &Tinf, double &k) const
+    {
+        double n = samples.size(), sx = 0, sy = 0, sxx = 0, sxy = 0;
+        for (const auto &[t, y] : samples) {
+            double x = exp(-t / tau);
+            sx += x;
+            sy += y;
+            sxx += x * x;
+            sxy += x * y;
+        }
+        double den = n * sxx - sx * sx;
+        k = den > 1e-12 * n * n ? (n * sxy - sx * sy) / den : 0;
+        Tinf = (sy - k * sx) / n;
+
+        double rss = 0;
+        for (const auto &[t, y] : samples) {
+            double r = y - Tinf - k * exp(-t / tau);
+            rss += r * r;
+        }
+        return rss;
+    }
+
+    void update()
+    {
+        auto rss = [this](double u) {
+            double a, b;
+            return solve_linear(exp(u), a, b);
+        };
+
+        // Coarse search on logarithmic scale followed by golden-section refinement
+        const unsigned steps = 16;
+        const double lo = log(tau_min), hi = log(tau_max), step = (hi - lo) / steps;
+        unsigned best = 0;
+        double best_rss = INFINITY;
+        for (unsigned i = 0; i <= steps; i++) {
+            double r = rss(lo + i * step);
+            if (r < best_rss) {
+                best_rss = r;
+                best = i;
+            }
+        }
+        double a = lo + (best > 0 ? best - 1 : 0) * step;
+        double b = lo + (best < steps ? best + 1 : steps) * step;
+        const double g = (sqrt(5) - 1) / 2;
+        double c = b - g * (b - a), d = a + g * (b - a);
+        double rc = rss(c), rd = rss(d);
+        while (b - a > 1e-4) {
+            if (rc < rd) {
+                b = d;
+                d = c;
+                rd = rc;
+                c = b - g * (b - a);
+                rc = rss(c);
+            } else {
+                a = c;
+                c = d;
+                rc = rd;
+                d = a + g * (b - a);
+                rd = rss(d);
+            }
+        }
+        tau = exp((a + b) / 2);
+        double r = solve_linear(tau, Tinf, k);
+        double n = samples.size();
+        rmse = sqrt(r / n);
+
+        // Standard error of T∞ from the covariance matrix σ²(JᵀJ)⁻¹
+        // of all three parameters.
+        double m[3][3] = { { 0 } };
+        for (const auto &[t, y] : samples) {
+            double x = exp(-t / tau);
+            double j[3] = { 1, x, k * t * x / (tau * tau) };
+            for (int p = 0; p < 3; p++)
+                for (int q = 0; q < 3; q++)
+                    m[p][q] += j[p] * j[q];
+        }
+        double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+            - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+            + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+        double inv00, den = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+        if (fabs(det) > 1e-12 * m[0][0] * m[1][1] * m[2][2])
+            inv00 = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) / det;
+        else if (den > 1e-12 * n * n) // τ is undetermined (e.g. k ≈ 0) - use T∞ and k only
+            inv00 = m[1][1] / den;
+        else // T∞ and k cannot be separated (τ ≫ measured time)
+            inv00 = NAN;
+        Tinf_err = n > 3 ? sqrt(r / (n - 3) * fabs(inv00)) : NAN;
+    }
+};
+vector<thermal_model_fit> fits;
+
+// Read all sensors and write a CSV row with the given time [ms]
+static void write_sample(EV_P_ double time)
 {
     CsvRow row(columns);
-    auto time = get_current_time();
     double temp = NAN;
+    vector<double> values(state.sensors.size());
     row.set(time_column, time);
+    if (phase_column)
+        row.set(*phase_column, phases.current_name());
 
     // Save sensor values
     for (unsigned i = 0; i < state.sensors.size(); ++i) {
-        double t = read_sensor(state.sensors[i].path.c_str());
+        double t = read_sensor(state.sensors[i]);
         if (isnan(temp))
             temp = t;
+        values[i] = t;
         row.set(state.sensors[i].column, t);
+        record_value(state.sensors[i].column, time, row.getValue(state.sensors[i].column), true);
     }
 
-    // Save last values of synchronous exec columns
-    for (auto &e : state.execs) {
-        if (!e->has_sync_column)
+    // Save last (or aggregated) values of synchronous exec/input columns
+    for (auto &src : state.sources) {
+        if (!src->has_sync_column)
             continue;
-        for (auto &c : e->columns) {
+        for (auto &c : src->columns) {
             if (!c.synchronous)
                 continue;
-            row.set(c.column, move(c.last_value));
-            c.last_value.erase();
+            c.store(row);
+            record_value(c.column, time, row.getValue(c.column));
         }
     }
 
@@ -710,18 +2298,74 @@ static void measure_timer_cb(EV_P_ ev_timer *w, int revents)
         read_procstat();
         for (unsigned i = 0; i < n_cpus; ++i) {
             row.set(cpus[i].column, get_cpu_usage(cpus[i]));
+            record_value(cpus[i].column, time, row.getValue(cpus[i].column), true);
         }
     }
 
-    row.write(state.out_fp);
+    output_row(row, true);
 
     if (csv_unbuffered)
         fflush(state.out_fp);
 
+    if (metrics_addr)
+        metrics.update(time);
+
     if (verbose) {
         fprintf(stderr, "\r%.1fs  %.1f°C   ", time / 1000.0, temp / 1000.0);
         verbose_needs_eol = true;
     }
+
+    // Baseline samples (before benchmark start) are not analyzed
+    if (time < 0)
+        return;
+
+    for (auto &f : fits) {
+        f.add(time / 1000.0, values[f.sensor] / 1000.0);
+        if (verbose)
+            fprintf(stderr, "%s: T∞=%.1f±%.1f°C τ=%.0fs   ", state.sensors[f.sensor].name.c_str(), f.Tinf,
+                    f.Tinf_err, f.tau);
+    }
+    if (!isnan(fit_stop) && state.child.running() && !state.child.terminating() && all_of(fits.begin(), fits.end(), [](auto &f) {
+            return f.samples.size() >= 10 && f.Tinf_err <= fit_stop;
+        })) {
+        verbose_ensure_eol();
+        fprintf(stderr, "Asymptotic temperature estimated with sufficient confidence after %.1fs\n",
+                time / 1000.0);
+        terminate_timer_cb(EV_A_ & terminate_timer, 0);
+    }
+
+    if (!isnan(steady_slope) && steady_state.update(time / 1000.0, values)) {
+        verbose_ensure_eol();
+        fprintf(stderr, "Steady state reached after %.1fs\n", steady_state.reached);
+        terminate_timer_cb(EV_A_ & terminate_timer, 0);
+    }
+}
+
+struct benchmark;
+static void start_benchmark(EV_P_ benchmark &bench);
+
+// With --baseline, the benchmark is started from the sampling timer
+// after baseline_ticks periods, so that its start sample replaces
+// the sample of that period and time stays monotonic.
+static benchmark *baseline_bench = nullptr;
+static int baseline_ticks = 0;
+
+// Returns true if the benchmark was started in this period
+static bool baseline_tick(EV_P)
+{
+    if (!baseline_bench || baseline_ticks-- > 0)
+        return false;
+    benchmark &bench = *baseline_bench;
+    baseline_bench = nullptr;
+    start_benchmark(EV_A_ bench);
+    return true;
+}
+
+static void measure_timer_cb(EV_P_ ev_timer *w, int revents)
+{
+    if (w == &measure_timer && baseline_tick(EV_A))
+        return;
+    write_sample(EV_A_ get_current_time());
 }
 
 static void randomized_timer_cb(EV_P_ ev_timer *w, int revents)
@@ -732,6 +2376,7 @@ static void randomized_timer_cb(EV_P_ ev_timer *w, int revents)
     // TODO: Detect this situation and handle it by by calling the
     // measure_timer_cb() from here.
     ev_timer_stop(loop, &randomized_timer);
+    baseline_tick(EV_A);
 
     ev_timer_init(&randomized_timer, measure_timer_cb, measure_period_ms / 1000.0 * rand() / RAND_MAX, 0.);
     ev_timer_start(loop, &randomized_timer);
@@ -739,11 +2384,10 @@ static void randomized_timer_cb(EV_P_ ev_timer *w, int revents)
 
 static void terminate_timer_cb(EV_P_ ev_timer *w, int revents)
 {
-    if (state.child != 0) {
+    if (state.child.running() && !state.child.terminating()) {
         verbose_ensure_eol();
         fprintf(stderr, "Waiting for child to terminate...\n");
-        kill(-state.child, SIGTERM);
-        state.child = 0;
+        state.child.terminate();
     }
 }
 
@@ -751,89 +2395,135 @@ static void terminate_timer_cb(EV_P_ ev_timer *w, int revents)
 static void sigint_cb(struct ev_loop *loop, ev_signal *w, int revents)
 {
     verbose_ensure_eol();
-    fprintf(stderr, "Waiting for child to terminate...\n");
+    interrupted = true;
 
-    if (state.child != 0) {
-        kill(-state.child, SIGTERM);
-        state.child = 0;
+    if (ev_is_active(&start_timer) || baseline_bench) {
+        // Interrupted while recording baseline - do not start the benchmark
+        ev_timer_stop(loop, &start_timer);
+        baseline_bench = nullptr;
+        child_exit_cb(loop);
+        return;
     }
 
+    fprintf(stderr, "Waiting for child to terminate...\n");
+
+    state.child.terminate();
+
     // When the child terminates, we get notified via child_exit_cb.
 }
 
-void measure(int measure_period_ms)
+// Benchmark and its stdout pipe
+struct benchmark {
+    int stdout_pipe[2];
+    ev::io stdout_watcher;
+    bool sampling; // Are there any sensors or synchronous columns?
+};
+
+// Start the benchmark so that its start is t=0 of the measurement.
+// If we are sampling, sensors are read just before the start and
+// stored as time 0.
+static void start_benchmark(EV_P_ benchmark &bench)
 {
-    int p[2];
-    CHECK(pipe(p));
+    struct timespec t0;
 
     if (verbose) {
         int argc = 0;
         while (benchmark_argv[argc] != NULL)
             argc++;
+        verbose_ensure_eol();
         fprintf(stderr, "Running: %s\n", shell_quote(argc, benchmark_argv).c_str());
     }
 
-    pid_t pid = fork();
-    if (pid == -1)
-        err(1, "fork");
-
-    if (pid == 0) { // Child process - benchmark
-        close(p[0]);
-        dup2(p[1], STDOUT_FILENO);
-        close(p[1]);
-
-        // Run the benchmark in background process group so that we
-        // can kill it with its all potential children.
-        setpgid(0, 0);
-        // Background processes are stopped when they happen to read
-        // from a controlling terminal. We don't want the benchmark to
-        // be stopped, so we do not run in on terminal. If stdin is
-        // not a terminal, we keep it connected to the child, because
-        // it can be a pipe with input data for the benchmark.
-        if (isatty(STDIN_FILENO))
-            CHECK(dup2(CHECK(open("/dev/null", O_RDONLY)), STDIN_FILENO));
-
-        execvp(benchmark_argv[0], benchmark_argv);
-        err(1, "exec(%s)", benchmark_argv[0]);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (bench.sampling) {
+        if (!randomize_timing)
+            ev_timer_stop(EV_A_ & measure_timer);
+        write_sample(EV_A_ 0);
     }
+    double read_ms = ms_since(t0);
 
-    // Parent process - measurement
-    ev::io child_stdout;
-    ev::child child_exit;
+    // Background processes are stopped when they happen to read
+    // from a controlling terminal. We don't want the benchmark to
+    // be stopped, so we do not run in on terminal. If stdin is
+    // not a terminal, we keep it connected to the child, because
+    // it can be a pipe with input data for the benchmark.
+    clock_gettime(CLOCK_MONOTONIC, &state.start_time);
+    state.started = true;
+    pid_t pid = spawn(benchmark_argv, bench.stdout_pipe[1], isatty(STDIN_FILENO), has_affinity ? &affinity : nullptr);
+    if (verbose) {
+        verbose_ensure_eol();
+        fprintf(stderr, "Benchmark started in %.3f ms (sensors read in %.3f ms)\n", ms_since(state.start_time),
+                read_ms);
+    }
+    close(bench.stdout_pipe[1]);
 
-    struct ev_loop *loop = EV_DEFAULT;
+    // Co-runs start together with COMMAND, not during the baseline
+    for (const auto &source : state.sources)
+        if (source->with_benchmark())
+            source->start(EV_A);
 
-    // Run the loop once to update time information. This ensures that
-    // all timers are relative to now and not to the start of the
-    // program, where the default loop was initialized. Due to
-    // cooldown waiting, the program start time can differ from now
-    // significantly. There are no watchers so no callback is invoked.
-    ev_run(loop, EVRUN_NOWAIT);
+    state.child.on_exit = [=]() { child_exit_cb(EV_A); };
+    state.child.watch(EV_A, pid);
 
-    ev_child_init(&child_exit, child_exit_cb, pid, 0);
-    ev_child_start(loop, &child_exit);
-    state.child = pid;
+    bench.stdout_watcher.set(EV_A);
+    bench.stdout_watcher.set<child_stdout_cb>();
+    bench.stdout_watcher.start(bench.stdout_pipe[0], ev::READ);
 
-    child_stdout_buf.reserve(0x10000);
-    CHECK(fcntl(p[0], F_SETFL, CHECK(fcntl(p[0], F_GETFL)) | O_NONBLOCK));
-    close(p[1]);
-    child_stdout.set<child_stdout_cb>();
-    child_stdout.start(p[0], ev::READ);
+    ev_now_update(EV_A);
+    if (bench.sampling && !randomize_timing) {
+        ev_timer_set(&measure_timer, measure_period_ms / 1000.0, measure_period_ms / 1000.0);
+        ev_timer_start(EV_A_ & measure_timer);
+    }
 
     if (terminate_time > 0) {
         ev_timer_init(&terminate_timer, terminate_timer_cb, terminate_time, 0);
-        ev_timer_start(loop, &terminate_timer);
+        ev_timer_start(EV_A_ & terminate_timer);
     }
+}
+
+static void start_timer_cb(EV_P_ ev_timer *w, int revents)
+{
+    start_benchmark(EV_A_ *static_cast<benchmark *>(w->data));
+}
+
+void measure(int measure_period_ms)
+{
+    benchmark bench = {};
+    state.started = false;
+    CHECK(pipe2(bench.stdout_pipe, O_CLOEXEC));
+    CHECK(fcntl(bench.stdout_pipe[0], F_SETFL, CHECK(fcntl(bench.stdout_pipe[0], F_GETFL)) | O_NONBLOCK));
+    child_stdout_buf.reserve(0x10000);
+
+    // We do not use the default loop, because its SIGCHLD handler
+    // would reap our children before we get their exit status and
+    // resource usage. Children are watched via pidfd instead.
+    static struct ev_loop *loop = ev_loop_new(EVFLAG_AUTO);
+
+    // Run the loop once to update time information. This ensures that
+    // all timers are relative to now and not to the time, when the
+    // loop was created or last run. Due to cooldown waiting, this can
+    // differ from now significantly. There are no watchers so no
+    // callback is invoked.
+    ev_run(loop, EVRUN_NOWAIT);
+
+    if (!isnan(steady_slope))
+        steady_state.init();
+    if (fit_enabled)
+        for (const sensor *s : select_sensors(fit_sensors, "--fit"))
+            fits.push_back(thermal_model_fit(s - &state.sensors[0]));
 
     ev_signal_init(&sigint_watcher, sigint_cb, SIGINT);
     ev_signal_start(loop, &sigint_watcher);
     ev_signal_init(&sigterm_watcher, sigint_cb, SIGTERM);
     ev_signal_start(loop, &sigterm_watcher);
 
-    bool have_sync_exec = false;
-    for (const auto &exec : state.execs) {
-        exec->start(loop);
-        have_sync_exec |= exec->has_sync_column;
+    // Helper processes are started first to not miss their values
+    // at the benchmark start.
+    bench.sampling = state.sensors.size() > 0;
+    for (const auto &source : state.sources) {
+        if (!source->with_benchmark())
+            source->start(loop);
+        bench.sampling |= source->has_sync_column;
     }
 
     if (!randomize_timing)
@@ -841,26 +2531,71 @@ void measure(int measure_period_ms)
     else
         ev_timer_init(&measure_timer, randomized_timer_cb, 0.0, measure_period_ms / 1000.0);
 
-    if (state.sensors.size() > 0 || have_sync_exec)
-        ev_timer_start(loop, &measure_timer);
-
     if (sched_deadline) {
         setup_sched_deadline(measure_period_ms * 1000000, measure_period_ms * 1000000 / 100 * sched_deadline_budget);
     } else {
-        int currpriority = getpriority(PRIO_PROCESS, getpid());
-        setpriority(PRIO_PROCESS, getpid(), currpriority - 1);
+        static bool priority_raised = false;
+        if (!priority_raised) {
+            int currpriority = getpriority(PRIO_PROCESS, getpid());
+            setpriority(PRIO_PROCESS, getpid(), currpriority - 1);
+            priority_raised = true;
+        }
     }
 
+    // Baseline samples get negative time. The baseline is rounded up
+    // to whole sampling periods.
+    baseline_ticks = (baseline_time * 1000 + measure_period_ms - 1) / measure_period_ms;
     clock_gettime(CLOCK_MONOTONIC, &state.start_time);
+    timespec_add_ms(state.start_time, baseline_ticks * measure_period_ms);
+
+    // Without baseline, periodic sampling starts with the benchmark
+    if (bench.sampling && (baseline_time > 0 || randomize_timing))
+        ev_timer_start(loop, &measure_timer);
+
+    if (baseline_time > 0) {
+        if (verbose)
+            fprintf(stderr, "Recording baseline for %ds\n", baseline_time);
+        if (bench.sampling) {
+            baseline_bench = &bench;
+        } else {
+            ev_timer_init(&start_timer, start_timer_cb, baseline_time, 0);
+            start_timer.data = &bench;
+            ev_timer_start(loop, &start_timer);
+        }
+    } else {
+        start_benchmark(loop, bench);
+    }
 
     ev_run(loop, 0);
 
+    kill_orphans();
+
     verbose_ensure_eol();
 }
 
 enum {
     OPT_UNBUFFERED = 1000,
     OPT_SCHED_DEADLINE,
+    OPT_FAN_STDIN,
+    OPT_WAIT_PERIOD,
+    OPT_WAIT_SENSORS,
+    OPT_WAIT_STABLE,
+    OPT_WAIT_PID,
+    OPT_STEADY_STATE,
+    OPT_STEADY_SENSORS,
+    OPT_FIT,
+    OPT_FIT_STOP,
+    OPT_JOBS,
+    OPT_CORUN,
+    OPT_AFFINITY,
+    OPT_KILL_TIMEOUT,
+    OPT_BASELINE,
+    OPT_PHASES,
+    OPT_STATS,
+    OPT_METRICS,
+    OPT_RECORDER,
+    OPT_TRIGGER,
+    OPT_EXEC_DIRECT,
 };
 
 static error_t parse_opt(int key, char *arg, struct argp_state *argp_state)
@@ -893,12 +2628,33 @@ static error_t parse_opt(int key, char *arg, struct argp_state *argp_state)
     case 'W':
         cooldown_timeout = atoi(arg);
         break;
+    case OPT_WAIT_SENSORS:
+        cooldown_sensors = arg;
+        break;
+    case OPT_WAIT_STABLE:
+        cooldown_stable = true;
+        if (arg && sscanf(arg, "%lf,%lf,%lf", &cooldown_tolerance, &cooldown_slope, &cooldown_hold) < 1)
+            argp_error(argp_state, "Invalid --wait-stable value: %s", arg);
+        break;
+    case OPT_WAIT_PID:
+        cooldown_ki = cooldown_kd = 0;
+        if (sscanf(arg, "%lf,%lf,%lf", &cooldown_kp, &cooldown_ki, &cooldown_kd) < 1)
+            argp_error(argp_state, "Invalid --wait-pid value: %s", arg);
+        break;
+    case OPT_WAIT_PERIOD:
+        cooldown_period_ms = atoi(arg);
+        if (cooldown_period_ms <= 0)
+            argp_error(argp_state, "--wait-period must be positive");
+        break;
     case 'f':
         fan_cmd = arg;
         break;
     case 'F':
         fan_on = (arg == 0) ? 1 : atof(arg);
         break;
+    case OPT_FAN_STDIN:
+        fan_stdin = true;
+        break;
     case 'n':
         bench_name = arg;
         break;
@@ -917,6 +2673,26 @@ static error_t parse_opt(int key, char *arg, struct argp_state *argp_state)
     case 't':
         terminate_time = atoi(arg);
         break;
+    case OPT_STEADY_STATE:
+        steady_slope = 0.1;
+        if (arg && sscanf(arg, "%lf,%lf", &steady_slope, &steady_window) < 1)
+            argp_error(argp_state, "Invalid --steady-state value: %s", arg);
+        if (!(steady_slope >= 0) || !(steady_window > 0))
+            argp_error(argp_state, "--steady-state values must be positive");
+        break;
+    case OPT_STEADY_SENSORS:
+        steady_sensors = arg;
+        break;
+    case OPT_FIT:
+        fit_enabled = true;
+        fit_sensors = arg;
+        break;
+    case OPT_FIT_STOP:
+        fit_enabled = true;
+        fit_stop = atof(arg);
+        if (!(fit_stop > 0))
+            argp_error(argp_state, "--fit-stop must be positive");
+        break;
     case 'u':
         calc_cpu_usage = true;
         break;
@@ -924,11 +2700,17 @@ static error_t parse_opt(int key, char *arg, struct argp_state *argp_state)
         verbose = true;
         break;
     case 'e':
-        state.execs.emplace_back(new Exec(arg));
+        state.sources.emplace_back(new Exec(arg));
         break;
     case 'E':
         exec_wait = true;
         break;
+    case OPT_EXEC_DIRECT:
+        exec_direct = true;
+        break;
+    case 'i':
+        state.sources.emplace_back(new Input(arg));
+        break;
     case OPT_UNBUFFERED:
         csv_unbuffered = true;
         break;
@@ -945,13 +2727,70 @@ static error_t parse_opt(int key, char *arg, struct argp_state *argp_state)
         else
             argp_error(argp_state, "COMMAND already specified with --benchmark");
         break;
+    case OPT_JOBS:
+        jobs_file = arg;
+        break;
+    case OPT_CORUN:
+        // Columns are created at the end, when all -c options are known
+        corun_specs.push_back(arg);
+        break;
+    case OPT_BASELINE:
+        baseline_time = atoi(arg);
+        if (baseline_time < 0)
+            argp_error(argp_state, "--baseline must not be negative");
+        break;
+    case OPT_PHASES:
+        track_phases = true;
+        break;
+    case OPT_STATS:
+        stats_enabled = true;
+        break;
+    case OPT_METRICS:
+        metrics_addr = arg;
+        break;
+    case OPT_RECORDER: {
+        char *end;
+        recorder.window = strtod(arg, &end) * 1000;
+        if (*end == ',')
+            recorder.decimation = strtoul(end + 1, &end, 10);
+        if (*end || recorder.window <= 0 || recorder.decimation == 0)
+            argp_error(argp_state, "Invalid --recorder argument: %s", arg);
+        break;
+    }
+    case OPT_TRIGGER:
+        trigger_specs.push_back(arg);
+        break;
+    case OPT_KILL_TIMEOUT:
+        kill_timeout = atof(arg);
+        if (kill_timeout < 0)
+            argp_error(argp_state, "--kill-timeout must not be negative");
+        break;
+    case OPT_AFFINITY:
+        parse_cpu_list(arg, affinity, "--affinity");
+        has_affinity = true;
+        break;
     case ARGP_KEY_END:
-        if (!benchmark_argv)
+        if (!benchmark_argv && !jobs_file)
             argp_error(argp_state, "COMMAND to run was not specified");
+        if (benchmark_argv && jobs_file)
+            argp_error(argp_state, "COMMAND cannot be combined with --jobs");
         if (!sensors_specified && state.sensors.size() == 0)
             add_all_thermal_zones();
-        if (!bench_name)
+        if (!bench_name && benchmark_argv)
             bench_name = basename(benchmark_argv[0]);
+        if (!isnan(cooldown_kp) && !fan_cmd)
+            argp_error(argp_state, "--wait-pid requires --fan-cmd");
+        if (!trigger_specs.empty() && !recorder.window)
+            argp_error(argp_state, "--trigger requires --recorder");
+        for (const auto &spec : corun_specs) {
+            Corun *corun = Corun::parse(spec);
+            for (const auto &src : state.sources) {
+                auto other = dynamic_cast<Corun *>(src.get());
+                if (other && other->name == corun->name)
+                    argp_error(argp_state, "Duplicate --corun name '%s'", corun->name.c_str());
+            }
+            state.sources.emplace_back(corun);
+        }
         break;
     default:
         return ARGP_ERR_UNKNOWN;
@@ -974,7 +2813,8 @@ static struct argp_option options[] = {
     { "sensors_file",   's', "FILE",        0,
       "Definition of sensors to use. Each line of the FILE contains either "
       "SPEC as in -S or, when the line starts with '!', the rest is "
-      "interpreted as an argument to --exec. Lines starting with '#' are "
+      "interpreted as an argument to --exec. Similarly, lines starting with "
+      "'<' are arguments to --input. Lines starting with '#' are "
       "ignored. When no sensors are specified via -s or -S, all available "
       "thermal zones are added automatically." },
     { "sensor",         'S', "SPEC",        0,
@@ -986,11 +2826,29 @@ static struct argp_option options[] = {
       "before running the COMMAND. Wait timeout is given by --wait-timeout." },
     { "wait-timeout",   'W', "SECS",        0,
       "Timeout in seconds for cool-down waiting (default: 600)." },
+    { "wait-period",    OPT_WAIT_PERIOD, "TIME [ms]", 0,
+      "Period of reading the temperature during cool-down waiting (default: 2000)." },
+    { "wait-sensors",   OPT_WAIT_SENSORS, "NAME[,...]", 0,
+      "Comma-separated names of sensors used for cool-down waiting or 'all'. "
+      "The highest of their temperatures is compared with TEMP. "
+      "Defaults to the first configured sensor." },
+    { "wait-stable",    OPT_WAIT_STABLE, "TOL[,SLOPE[,HOLD]]", OPTION_ARG_OPTIONAL,
+      "Instead of waiting for the temperature to drop to TEMP, wait until it "
+      "stays below TEMP+TOL °C and its slope is within ±SLOPE °C/min for "
+      "HOLD seconds (defaults: 1, 0.2 and 30)." },
+    { "wait-pid",       OPT_WAIT_PID, "KP[,KI[,KD]]", 0,
+      "Control the fan during cool-down waiting with a PID controller to "
+      "reach TEMP without undercooling. The gains are fan speed (0-1) per °C, "
+      "per °C·s and per °C/s respectively. Useful with --wait-stable and --fan-stdin." },
     { "fan-cmd",        'f', "CMD",         0,
       "Command to control the fan. The command is invoked as 'CMD <speed>', "
       "where <speed> is a number between 0 and 1. Zero means the fan is off, one means full speed." },
     { "fan-on",         'F', "SPEED",       OPTION_ARG_OPTIONAL,
       "Set the fan speed while running COMMAND. If SPEED is not given, it defaults to '1'." },
+    { "fan-stdin",      OPT_FAN_STDIN, 0,   0,
+      "Start the fan command only once and send the speeds to its stdin, one per line. "
+      "After setting each speed, the command must print one line to its stdout. "
+      "This avoids starting a new process (e.g. ssh) for every speed change." },
     { "name",           'n', "NAME",        0, "Basename of the .csv file" },
     { "bench_name",     'n', 0,             OPTION_ALIAS | OPTION_HIDDEN },
     { "output_dir",     'o', "DIR",         0, "Where to create output .csv file" },
@@ -998,8 +2856,58 @@ static struct argp_option options[] = {
       "The name of output CSV file (overrides -o and -n). Hyphen (-) means standard output" },
     { "column",         'c', "STR",         0, "Add column to CSV populated by STR=val lines from COMMAND stdout" },
     { "stdout",         'l', 0,             0, "Log COMMAND's stdout to CSV" },
+    { "phases",         OPT_PHASES,     0,  0,
+      "Recognize '@phase=NAME' lines in COMMAND's stdout as the start of "
+      "benchmark phase NAME. The phase is stored in the 'phase' column and "
+      "per-phase statistics (duration, mean values and rates of change of "
+      "numeric columns, e.g. work done per second) are printed at the end." },
     { "time",           't', "SECONDS",     0, "Terminate the COMMAND after this time" },
+    { "baseline",       OPT_BASELINE,   "SECONDS", 0,
+      "Record samples for SECONDS before starting the COMMAND (after "
+      "cool-down). These baseline rows have negative time. Useful for "
+      "calculation of temperature increase caused by the COMMAND. Co-runs "
+      "(--corun) start together with the COMMAND." },
+    { "kill-timeout",   OPT_KILL_TIMEOUT, "SECONDS", 0,
+      "When the COMMAND (or --exec CMD) does not exit within SECONDS after "
+      "SIGTERM, it is killed with SIGKILL (default: 5, 0 means never)." },
+    { "steady-state",   OPT_STEADY_STATE, "SLOPE[,WINDOW]", OPTION_ARG_OPTIONAL,
+      "Terminate the COMMAND when temperatures reach steady state, i.e. when "
+      "the slope of their linear regression over the last WINDOW seconds is "
+      "within ±SLOPE °C/min (defaults: 0.1 and 60)." },
+    { "steady-sensors", OPT_STEADY_SENSORS, "NAME[,...]", 0,
+      "Comma-separated names of sensors used for steady-state detection or "
+      "'all'. Defaults to the first configured sensor." },
+    { "fit",            OPT_FIT,        "NAME[,...]", OPTION_ARG_OPTIONAL,
+      "Fit the thermal model T(t) = Tinf + k·exp(-t/tau) to the data of the "
+      "named sensors (or 'all', default is the first sensor) during the "
+      "measurement. The estimates are printed in verbose mode and stored at "
+      "the end of the CSV file." },
+    { "fit-stop",       OPT_FIT_STOP,   "STDERR [°C]", 0,
+      "Terminate the COMMAND when the standard error of Tinf estimated by "
+      "--fit drops below STDERR for all fitted sensors. Implies --fit." },
     { "cpu-usage",      'u', 0,             0, "Calculate and log CPU usage." },
+    { "stats",          OPT_STATS,      0,  0,
+      "Calculate summary statistics (count, mean, standard deviation, min, "
+      "max, percentiles and rate of increasing counters such as work_done) "
+      "of numeric columns during the measurement. The statistics are "
+      "stored at the end of the CSV file and in a JSON file next to it "
+      "(with .csv replaced by .json)." },
+    { "metrics",        OPT_METRICS,    "[HOST:]PORT|PATH", 0,
+      "Serve the last sample and summary statistics of numeric columns in "
+      "Prometheus text format via HTTP on TCP PORT (HOST defaults to "
+      "localhost) or on Unix socket PATH (must contain '/')." },
+    { "recorder",       OPT_RECORDER,   "SECONDS[,N]", 0,
+      "Flight recorder mode: Write only every N-th sample (default 10) to "
+      "the CSV file, but keep all rows of the last SECONDS in memory. When "
+      "a --trigger fires, write them and the rows of the next SECONDS to "
+      "file NAME-triggerK.csv. A trigger firing during that time extends "
+      "the file by another SECONDS." },
+    { "trigger",        OPT_TRIGGER,    "COL[<>~]...", 0,
+      "Trigger condition for --recorder: 'COL>VALUE' or 'COL<VALUE' fires "
+      "when the value of column COL crosses VALUE (e.g. temperature "
+      "threshold or frequency drop), 'COL~' fires when the value changes "
+      "(e.g. cooling device state) and 'COL' fires on any value (e.g. "
+      "COMMAND's stdout key). Can be given multiple times." },
     { "exec",           'e', "[(COL[,...])]CMD",  0,
 
       "Execute CMD (in addition to COMMAND) and store its stdout in relevant "
@@ -1007,15 +2915,56 @@ static struct argp_option options[] = {
       "store the rest of stdout lines starting with KEY= in column KEY. If "
       "COL start with '@' values are not stored immediately when received but "
       "the last value is remembered and stored synchronously with other "
-      "sensors. Otherwise all non-matching lines will be stored in column "
-      "COL. If no COL is specified, first word of CMD is used as COL "
-      "specification.\n"
-      //
-      "Example: --exec '(amb1=,@amb2=,amb_other) ssh ambient@turbot read_temp'"
+      "sensors. Instead of the last value, '@OP:COL' stores the result of "
+      "aggregation operation OP (one of last, mean, min, max, sum or count) "
+      "applied to all values received since the previous sensor reading; "
+      "the column name is then suffixed with '_OP'. Otherwise all "
+      "non-matching lines will be stored in column COL. If no COL is "
+      "specified, first word of CMD is used as COL specification. "
+      "Examples: --exec '(amb1=,@amb2=,amb_other) ssh ambient@turbot "
+      "read_temp', --exec '(@mean:power=,@max:power=) powermeter'"
+
+    },
+    { "corun",          OPT_CORUN,      "[NAME][@CPUS]:CMD", 0,
+
+      "Run CMD concurrently with COMMAND, e.g. to measure interference "
+      "between benchmarks. CMD is started and terminated together with "
+      "COMMAND and, if CPUS (e.g. 0-3,6) is given, its CPU affinity is set "
+      "accordingly. Values printed by CMD are stored as for COMMAND (see -c "
+      "and -l), but the column names are prefixed with 'NAME_'. The default "
+      "NAME is the first word of CMD. Can be used multiple times."
 
     },
+    { "affinity",       OPT_AFFINITY,   "CPUS", 0,
+      "Set CPU affinity of COMMAND to CPUS, e.g. 0-3,6." },
     { "exec-wait",      'E', 0,             0,
       "Wait for --exec processes to finish. Do not kill them (useful for testing)." },
+    { "exec-direct",    OPT_EXEC_DIRECT, 0, 0,
+      "Execute --exec and --corun commands without /bin/sh if they contain "
+      "no shell metacharacters. This saves the shell startup, but shell "
+      "builtins cannot be used as CMD." },
+    { "input",          'i', "[(COL[,...])]PATH",  0,
+
+      "Read lines from Unix domain socket or named pipe (FIFO) at PATH and "
+      "store them in CSV columns as specified by COL. COL has the same "
+      "meaning as in --exec. If no COL is specified, the last component of "
+      "PATH is used as COL specification. If the socket does not exist or "
+      "the connection is closed, thermobench tries to reconnect every second."
+
+    },
+    { "jobs",           OPT_JOBS,       "FILE", 0,
+
+      "Run a campaign of benchmarks specified in FILE instead of a single "
+      "COMMAND. Jobs are run sequentially, with cool-down waiting (if "
+      "enabled) before each run, and their results are stored in DIR "
+      "(see -o) as NAME.csv or NAME-REP.csv. An index of all runs is "
+      "written to FILE given by -O (default: DIR/index.csv). Each line "
+      "of the jobs FILE is either 'PARAM = VALUE...' or "
+      "'NAME[*REPETITIONS]: CMD'. CMD is run by /bin/sh. Occurrences of "
+      "{PARAM} in NAME and CMD are replaced with all combinations of the "
+      "parameter values."
+
+    },
     { "unbuffered",     OPT_UNBUFFERED, 0,  0, "Flush CSV to disk after every row." },
     { "verbose",        'v', 0,             0, "Print progress information to stderr." },
     { "sched-deadline", OPT_SCHED_DEADLINE, "BUDGET%", OPTION_ARG_OPTIONAL,
@@ -1032,7 +2981,7 @@ const char * argp_program_version = "thermobench " GIT_VERSION;
 
 /* Our argp parser. */
 static struct argp argp = {
-    options, parse_opt, "[--] COMMAND...",
+    options, parse_opt, "[--] COMMAND...\n--jobs=FILE",
 
     "Runs a benchmark COMMAND and stores the values from temperature (and "
     "other) sensors in a .csv file. "
@@ -1149,11 +3098,28 @@ string cpu::getHeader(unsigned idx)
     return header.str();
 }
 
-int main(int argc, char **argv)
+static string describe_status(int status)
 {
-    argp_parse(&argp, argc, argv, 0, 0, NULL);
+    if (WIFSIGNALED(status))
+        return string("killed by signal: ") + strsignal(WTERMSIG(status));
+    return "exit status: " + to_string(WEXITSTATUS(status));
+}
 
-    srand(time(NULL));
+static void run_benchmark(int argc, char **argv, const string &info)
+{
+    // Reset the state of the previous run (--jobs)
+    cooldown_trajectory.clear();
+    steady_state = steady_state_detector();
+    fits.clear();
+    phases.reset();
+    summaries.clear();
+    recorder.init();
+    child_stdout_buf.clear();
+    for (auto &c : state.stdoutColumns)
+        c.reset();
+    for (auto &source : state.sources)
+        for (auto &c : source->columns)
+            c.reset();
 
     if (!isnan(cooldown_temp))
         wait_cooldown(fan_cmd);
@@ -1161,13 +3127,8 @@ int main(int argc, char **argv)
     if (!isnan(fan_on) && fan_cmd)
         set_fan(fan_cmd, fan_on);
 
-    if (!out_file)
-        CHECK(asprintf(&out_file, "%s/%s.csv", output_path, bench_name));
-
-    if (calc_cpu_usage) {
-        n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
-        read_procstat(); // first read to initialize cpu_usage vars
-    }
+    if (calc_cpu_usage)
+        read_procstat(); // Do not include cool-down in the first value
 
     if (strcmp(out_file, "-") != 0) {
         if (verbose)
@@ -1181,25 +3142,235 @@ int main(int argc, char **argv)
 
     fprintf(state.out_fp, "# Started at: %s, Version: %s, Generated by: %s\n", current_time().c_str(), GIT_VERSION,
             shell_quote(argc, argv).c_str());
+    if (!info.empty())
+        fprintf(state.out_fp, "# %s\n", info.c_str());
+    write_cooldown_log(state.out_fp);
 
-    if (write_stdout)
-        stdout_column = &(columns.add("stdout"));
     CsvRow row(columns);
     columns.setHeader(row);
     row.write(state.out_fp);
     if (csv_unbuffered)
         fflush(state.out_fp);
 
+    measure(measure_period_ms);
+
+    const Process &c = state.child;
+    if (!state.started)
+        fprintf(state.out_fp, "# Benchmark not started (interrupted)\n");
+    else
+        fprintf(state.out_fp, "# Benchmark %s, max. RSS: %ld kB, user time: %.3f s, system time: %.3f s\n",
+                describe_status(c.status).c_str(), c.usage.ru_maxrss,
+                c.usage.ru_utime.tv_sec + c.usage.ru_utime.tv_usec * 1e-6,
+                c.usage.ru_stime.tv_sec + c.usage.ru_stime.tv_usec * 1e-6);
+
+    if (!isnan(steady_state.reached))
+        fprintf(state.out_fp, "# Steady state reached at: %.3f s, max. slope: %.3g °C/min\n", steady_state.reached,
+                steady_state.max_slope);
+    for (const auto &f : fits)
+        fprintf(state.out_fp, "# Fit %s: Tinf: %.2f °C, Tinf_stderr: %.3g °C, k: %.2f °C, tau: %.1f s, rmse: %.3g °C\n",
+                state.sensors[f.sensor].name.c_str(), f.Tinf, f.Tinf_err, f.k, f.tau, f.rmse);
+    phases.write(state.out_fp);
+    phases.write(stderr);
+    if (recorder.window) {
+        recorder.stop_dump();
+        fprintf(state.out_fp, "# Flight recorder: %u trigger(s) fired, %u dump(s) written\n", recorder.fired,
+                recorder.dumps);
+    }
+    if (stats_enabled)
+        write_stats(state.out_fp);
+
+    fclose(state.out_fp);
+
+    if (strcmp(out_file, "-") != 0) {
+        if (stats_enabled)
+            write_stats_json(out_file);
+        fprintf(stderr, "Results stored to %s\n", out_file);
+    }
+}
+
+struct job {
+    string name;
+    string cmd;
+    unsigned repetitions;
+};
+
+static string replace_all(string str, const string &from, const string &to)
+{
+    for (size_t pos = 0; (pos = str.find(from, pos)) != string::npos; pos += to.size())
+        str.replace(pos, from.size(), to);
+    return str;
+}
+
+// Create jobs for all combinations of parameters referenced in name or cmd
+static void expand_job(const job &j, const map<string, vector<string>> &params, vector<job> &jobs)
+{
+    for (const auto &[param, values] : params) {
+        const string ref = "{" + param + "}";
+        if (j.name.find(ref) == string::npos && j.cmd.find(ref) == string::npos)
+            continue;
+        for (const auto &value : values)
+            expand_job({ replace_all(j.name, ref, value), replace_all(j.cmd, ref, value), j.repetitions }, params,
+                       jobs);
+        return;
+    }
+    for (const auto &other : jobs)
+        if (other.name == j.name)
+            errx(1, "%s: Duplicate job name '%s'", jobs_file, j.name.c_str());
+    jobs.push_back(j);
+}
+
+static vector<job> read_jobs(const char *jobs_file)
+{
+    ifstream in(jobs_file);
+    if (!in)
+        err(1, "open(%s)", jobs_file);
+
+    static const regex param_re(R"(\s*([A-Za-z_][A-Za-z0-9_]*)\s*=(.*))");
+    static const regex job_re(R"(\s*([^\s*:]+)(\*([0-9]+))?:\s*(.*\S)\s*)");
+    map<string, vector<string>> params;
+    vector<job> jobs;
+    string line;
+    smatch m;
+
+    for (unsigned lineno = 1; getline(in, line); lineno++) {
+        if (line.find_first_not_of(" \t") == string::npos || line[line.find_first_not_of(" \t")] == '#')
+            continue;
+        if (regex_match(line, m, param_re)) {
+            params[m[1]] = split_words(m[2]);
+        } else if (regex_match(line, m, job_re)) {
+            unsigned reps = m[3].matched ? stoul(m[3]) : 1;
+            if (reps == 0)
+                errx(1, "%s:%u: Invalid number of repetitions", jobs_file, lineno);
+            expand_job({ m[1], m[4], reps }, params, jobs);
+        } else {
+            errx(1, "%s:%u: Invalid line: %s", jobs_file, lineno, line.c_str());
+        }
+    }
+    if (jobs.empty())
+        errx(1, "%s: No jobs specified", jobs_file);
+    return jobs;
+}
+
+// Name of the CSV file of the given repetition of job j
+static string job_file(const job &j, unsigned rep)
+{
+    if (j.repetitions > 1)
+        return string(output_path) + "/" + j.name + "-" + to_string(rep) + ".csv";
+    return string(output_path) + "/" + j.name + ".csv";
+}
+
+// Run all jobs from jobs_file and write the index of produced files
+static void run_campaign(int argc, char **argv)
+{
+    const vector<job> jobs = read_jobs(jobs_file);
+    unsigned total = 0, n = 0;
+    for (const auto &j : jobs)
+        total += j.repetitions;
+
+    char *index_file = out_file;
+    if (!index_file)
+        CHECK(asprintf(&index_file, "%s/index.csv", output_path));
+
+    // Different jobs must not overwrite each other's results, e.g.
+    // NAME*2 (NAME-1.csv, NAME-2.csv) and NAME-1
+    set<string> files = { index_file };
+    for (const auto &j : jobs)
+        for (unsigned rep = 1; rep <= j.repetitions; rep++)
+            if (!files.insert(job_file(j, rep)).second)
+                errx(1, "%s: Job '%s' would overwrite %s", jobs_file, j.name.c_str(), job_file(j, rep).c_str());
+    FILE *index_fp = fopen(index_file, "w");
+    if (index_fp == NULL)
+        err(1, "open(%s)", index_file);
+
+    CsvColumns index_columns;
+    const CsvColumn &job_col = index_columns.add("job");
+    const CsvColumn &rep_col = index_columns.add("repetition");
+    const CsvColumn &file_col = index_columns.add("file");
+    const CsvColumn &start_col = index_columns.add("started");
+    const CsvColumn &duration_col = index_columns.add("duration/s");
+    const CsvColumn &status_col = index_columns.add("status");
+    const CsvColumn &cmd_col = index_columns.add("command");
+    CsvRow row(index_columns);
+    index_columns.setHeader(row);
+    row.write(index_fp);
+
+    for (const auto &j : jobs) {
+        for (unsigned rep = 1; rep <= j.repetitions && !interrupted; rep++) {
+            string cmd = j.cmd;
+            char *job_argv[] = { (char *)"/bin/sh", (char *)"-c", cmd.data(), NULL };
+            benchmark_argv = job_argv;
+            CHECK(asprintf(&out_file, "%s", job_file(j, rep).c_str()));
+
+            fprintf(stderr, "Job %u/%u: %s (repetition %u/%u)\n", ++n, total, j.name.c_str(), rep, j.repetitions);
+            string started = current_time();
+            struct timespec start;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+
+            run_benchmark(argc, argv,
+                          "Job: " + j.name + ", Repetition: " + to_string(rep) + "/" + to_string(j.repetitions)
+                              + ", Command: " + j.cmd);
+
+            row.clear();
+            row.set(job_col, j.name);
+            row.set(rep_col, rep);
+            row.set(file_col, string(out_file));
+            row.set(start_col, started);
+            row.set(duration_col, ms_since(start) / 1000.0);
+            row.set(status_col, describe_status(state.child.status));
+            row.set(cmd_col, j.cmd);
+            row.write(index_fp);
+            fflush(index_fp);
+            free(out_file);
+        }
+    }
+    fclose(index_fp);
+    fprintf(stderr, "Index of results stored to %s\n", index_file);
+}
+
+int main(int argc, char **argv)
+{
+    argp_parse(&argp, argc, argv, 0, 0, NULL);
+
+    srand(time(NULL));
+
+    if (fan_cmd && fan_stdin)
+        start_fan_coproc(fan_cmd);
+
+    if (calc_cpu_usage) {
+        n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        read_procstat(); // first read to initialize cpu_usage vars
+    }
+
+    if (write_stdout)
+        stdout_column = &(columns.add("stdout"));
+    if (track_phases)
+        phase_column = &(columns.add("phase"));
+
     // Clear signal mask in children - don't let them inherit our
     // mask, which libev "randomly" modifies
     pthread_atfork(0, 0, clear_sig_mask);
 
-    measure(measure_period_ms);
+    // Become parent of processes that escape from the benchmark (e.g.
+    // daemons) so that we can kill them at the end.
+    prctl(PR_SET_CHILD_SUBREAPER, 1);
 
-    fclose(state.out_fp);
+    if (metrics_addr)
+        metrics.start(metrics_addr);
 
-    if (strcmp(out_file, "-") != 0)
-        fprintf(stderr, "Results stored to %s\n", out_file);
+    if (jobs_file) {
+        run_campaign(argc, argv);
+    } else {
+        if (!out_file)
+            CHECK(asprintf(&out_file, "%s/%s.csv", output_path, bench_name));
+        run_benchmark(argc, argv, "");
+    }
 
+    stop_fan_coproc();
+
+    int status = state.child.status;
+    if (!jobs_file && WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "Benchmark exited with status %d\n", WEXITSTATUS(status));
+        return WEXITSTATUS(status);
+    }
     return 0;
 }
@@ -1,17 +1,29 @@
 #!/usr/bin/env bash
 . testlib
-plan_tests 6
+plan_tests 12
 
 out=$(thermobench -O- -s/dev/null -- true)
 ok $? "exit code"
 okx grep "^time/ms" <<<$out
 
-TODO="Notify about non-zero exit codes"
-out=$(thermobench -O- -s/dev/null -- false)
+out=$(thermobench -O- -s/dev/null -- false 2>/dev/null)
 is $? 1 "exit code"
-unset TODO
 
 out=$(thermobench -O- -s/dev/null --stdout -- echo ahoy)
 ok $? "exit code"
 is "$(sed -ne 2p <<<$out)" "time/ms,stdout" "header"
 like "$(sed -ne 3p <<<$out)" "[0-9.]+,ahoy$" "stdout in CSV"
+
+out=$(thermobench -O/dev/null -s/dev/null --verbose -- true 2>&1)
+like "$out" "Benchmark started in [0-9.]+ ms" "start latency reported"
+
+out=$(thermobench -O/dev/null -s/dev/null -- /nonexistent 2>&1)
+is $? 127 "exit code"
+like "$out" "exec\(/nonexistent\): No such file or directory" "exec error reported"
+
+out=$(thermobench -O/dev/null -s/dev/null -e 'cd /' -- sleep 0.2 2>&1)
+ok $? "exit code with shell builtin in --exec"
+unlike "$out" "exited with status" "--exec runs in the shell by default"
+
+out=$(thermobench -O/dev/null -s/dev/null --exec-direct -e /nonexistent -- sleep 0.2 2>&1)
+like "$out" "Command '/nonexistent' exited with status 127" "--exec-direct exec error is the exit status"
@@ -0,0 +1,22 @@
+#!/usr/bin/env bash
+. testlib
+plan_tests 9
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+echo 30000 > "$tmp/cpu"
+
+out=$(thermobench -O- -S"$tmp/cpu cpu" -p 200 -c x -- sh -c 'echo x=1; sleep 0.3')
+ok $? "exit code"
+is "$(sed -ne 3p <<<$out)" "0,30000," "first sample at benchmark start"
+
+out=$(thermobench -O- -S"$tmp/cpu cpu" -p 200 --baseline=1 -- sleep 0.1)
+ok $? "exit code"
+like "$(sed -ne 3p <<<$out)" "^-(999\.[0-9]+|1000),30000$" "baseline starts at -1s"
+is "$(grep -c '^-' <<<$out)" 5 "baseline samples"
+is "$(grep -c '^0,30000$' <<<$out)" 1 "sample at benchmark start"
+okx awk -F, '/^-?[0-9]/ { if (NR > 3 && $1 < prev) exit 1; prev = $1 }' <<<"$out"
+
+out=$(thermobench -O- -S"$tmp/cpu cpu" -p 200 --baseline=1 -c x --corun 'c:sh -c "echo x=1"' -- sleep 0.3)
+ok $? "exit code with co-run"
+is "$(awk -F, '$4 == 1 { print ($1 >= 0) }' <<<"$out")" 1 "co-run starts with the benchmark, not in baseline"
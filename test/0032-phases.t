@@ -0,0 +1,26 @@
+#!/usr/bin/env bash
+. testlib
+plan_tests 10
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+echo 30000 > "$tmp/cpu"
+
+out=$(thermobench -O- -S"$tmp/cpu cpu" -c work -l -- sh -c 'echo @phase=run; echo work=1')
+okx grep -q "^[0-9.]*,,,@phase=run$" <<<$out
+
+out=$(thermobench -O- -S"$tmp/cpu cpu" -p 100 -c work --phases -- sh -c \
+    'echo @phase=init; echo work=0; sleep 0.3; echo @phase=run; echo work=0; sleep 0.5; echo work=100; echo @phase=verify; sleep 0.1' \
+    2>"$tmp/err")
+ok $? "exit code"
+is "$(sed -ne 2p <<<$out)" "time/ms,cpu,work,phase" "phase column in header"
+like "$out" "[0-9.]+,,,run" "phase marker row"
+like "$out" "[0-9.]+,30000,,run" "samples carry the current phase"
+run=$(grep '^# Phase run' <<<$out)
+like "$run" "^# Phase run: duration: [0-9.]+ s, cpu: 30000, work: 50 \([0-9.]+/s\)$" \
+     "run phase summary with work rate"
+# Wide bounds: the phase lasts 0.5 s and does 100 units of work
+okx awk -v d="$(sed -ne 's/.*duration: \([0-9.]*\) s.*/\1/p' <<<"$run")" 'BEGIN { exit !(d > 0.4 && d < 2) }'
+okx awk -v r="$(sed -ne 's/.*(\([0-9.]*\)\/s)$/\1/p' <<<"$run")" 'BEGIN { exit !(r > 50 && r < 250) }'
+is "$(grep '^# Phase' <<<$out | cut -d: -f1 | tr '\n' ' ')" "# Phase init # Phase run # Phase verify " "phases in order"
+is "$(grep -c '^# Phase' "$tmp/err")" 3 "summaries printed to stderr"
@@ -0,0 +1,19 @@
+#!/usr/bin/env bash
+. testlib
+plan_tests 6
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+echo 30000 > "$tmp/cpu"
+
+okx thermobench -O"$tmp/out.csv" -S"$tmp/cpu cpu" -p 100 -c work --stats -- \
+    sh -c 'for i in 0 1 2 3 4 5 6 7 8 9 10; do echo work=$i; sleep 0.05; done'
+is "$(grep '^# Stats cpu' "$tmp/out.csv")" \
+   "# Stats cpu: count: $(grep -c ',30000,' "$tmp/out.csv"), mean: 30000, stddev: 0, min: 30000, max: 30000, p50: 30000, p90: 30000, p99: 30000" \
+   "sensor statistics without rate"
+like "$(grep '^# Stats work' "$tmp/out.csv")" \
+     "^# Stats work: count: 11, mean: 5, stddev: 3.3166[0-9]*, min: 0, max: 10, p50: 5, p90: 9.4, p99: 10, rate: [0-9]+(\.[0-9]+)?/s$" \
+     "counter statistics with rate"
+ok $(test -f "$tmp/out.json"; echo $?) "JSON file created"
+like "$(cat "$tmp/out.json")" '"work": \{ "count": 11, "mean": 5, ' "JSON statistics"
+like "$(cat "$tmp/out.json")" '"cpu": \{ [^}]*"rate": null \}' "no rate for sensors in JSON"
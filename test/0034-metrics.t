@@ -0,0 +1,30 @@
+#!/usr/bin/env bash
+. testlib
+plan_tests 9
+
+tmp=$(mktemp -d)
+trap 'kill %1 2>/dev/null; rm -rf "$tmp"' EXIT
+echo 30000 > "$tmp/cpu"
+
+thermobench -O"$tmp/out.csv" -S"$tmp/cpu cpu" -p 100 -c work --metrics="$tmp/metrics.sock" -- \
+    sh -c 'i=0; while [ $i -lt 30 ]; do echo work=$((i*10)); i=$((i+1)); sleep 0.1; done' 2>/dev/null &
+
+for i in $(seq 50); do
+    out=$(curl -sf --unix-socket "$tmp/metrics.sock" http://localhost/metrics)
+    grep -q 'thermobench_rate{column="work"}' <<<$out && break
+    sleep 0.1
+done
+like "$out" 'thermobench_samples_total [1-9]' "samples counter"
+like "$out" 'thermobench_value\{column="cpu"\} 30000' "last sensor value"
+like "$out" 'thermobench_mean\{column="cpu"\} 30000' "mean sensor value"
+unlike "$out" 'thermobench_rate\{column="cpu"\}' "no rate for sensors"
+like "$out" 'thermobench_rate\{column="work"\} [1-9][0-9]*(\.[0-9]+)?' "work rate"
+
+wait %1
+ok $? "exit code"
+okx test ! -e "$tmp/metrics.sock"
+unlike "$(cat "$tmp/out.csv")" '# Stats' "no stats trailer without --stats"
+
+echo data > "$tmp/data.csv"
+thermobench -O/dev/null --metrics="$tmp/data.csv" -- true 2>/dev/null
+is "$(cat "$tmp/data.csv")" data "non-socket file is not removed"
@@ -0,0 +1,32 @@
+#!/usr/bin/env bash
+. testlib
+plan_tests 11
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+echo 30000 > "$tmp/cpu"
+
+okx thermobench -O"$tmp/out.csv" -S"$tmp/cpu cpu" -p 20 --recorder=0.2,10 --trigger='cpu>80000' -- \
+    sh -c "sleep 0.5; echo 90000 > $tmp/cpu; sleep 0.5"
+samples=$(grep -c '^[0-9.]*,[0-9]*$' "$tmp/out.csv")
+okx test $samples -ge 3 -a $samples -le 8
+is "$(grep '^# Flight' "$tmp/out.csv")" "# Flight recorder: 1 trigger(s) fired, 1 dump(s) written" "trigger count"
+is "$(sed -ne 2p "$tmp/out-trigger1.csv")" "time/ms,cpu" "header in dump"
+before=$(grep -c ',30000$' "$tmp/out-trigger1.csv")
+okx test $before -ge 5 -a $before -le 12
+after=$(grep -c ',90000$' "$tmp/out-trigger1.csv")
+okx test $after -ge 5 -a $after -le 13
+
+echo 30000 > "$tmp/cpu"
+okx thermobench -O"$tmp/two.csv" -S"$tmp/cpu cpu" -p 20 --recorder=0.5 --trigger='cpu>80000' -- \
+    sh -c "sleep 0.3; echo 90000 > $tmp/cpu; sleep 0.1; echo 30000 > $tmp/cpu; sleep 0.1; echo 90000 > $tmp/cpu; sleep 0.3"
+is "$(grep '^# Flight' "$tmp/two.csv")" "# Flight recorder: 2 trigger(s) fired, 1 dump(s) written" \
+   "trigger during dump extends it"
+is "$(grep -c '^# Trigger' "$tmp/two-trigger1.csv")" 2 "both triggers in dump"
+
+thermobench -O"$tmp/key.csv" -s/dev/null -c event -p 1000 --recorder=1 --trigger=event -- \
+    sh -c 'echo x=1; echo event=throttled' 2>/dev/null
+like "$(cat "$tmp/key-trigger1.csv")" "throttled" "stdout key trigger"
+
+thermobench -O/dev/null -s/dev/null --trigger=x -- true 2>/dev/null
+is $? 64 "--trigger requires --recorder"
@@ -1,6 +1,6 @@
 #!/usr/bin/env bash
 . testlib
-plan_tests 27
+plan_tests 32
 
 out=$(thermobench -O- -s/dev/null -E --exec="echo value" -- true)
 ok $? "exit code"
@@ -64,3 +64,13 @@ is "${line[1]}" "time/ms,uptime,seq,other"
 for i in $(seq 9); do grep -q "val$i" <<<$out && (( matches++ )); done
 # Most likely only one value appears in the output. In the worst case three values (almost never 9)
 okx test $matches -ge 1 -a $matches -le 3
+
+out=$(thermobench -O- -s/dev/null -E --exec='(@mean:v=,@max:v=,@count:v=,@sum:x) printf "v=1\nv=2\nv=6\n3\nfoo\n4\n"' -p 200 -- sleep 0.5)
+ok $? "exit code"
+readarray -t line <<<$out
+is "${line[1]}" "time/ms,v_mean,v_max,v_count,x_sum"
+is "$(grep -c ',3,6,3,7$' <<<$out)" 1 "aggregated values stored in one row"
+okx grep -qE "^[0-9.]+,,,0,0$" <<<$out
+
+out=$(thermobench -O- -s/dev/null -E --exec='(@avg:v=) echo' -- true)
+is $? 1 "unknown aggregation"
@@ -0,0 +1,19 @@
+#!/usr/bin/env bash
+. testlib
+plan_tests 5
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+echo 40000 > "$tmp/cpu"
+
+okx timeout 5s thermobench -O"$tmp/out.csv" -S"$tmp/cpu cpu" -p100 --steady-state=0.1,0.5 -- sleep inf
+like "$(tail -n1 "$tmp/out.csv")" "^# Steady state reached at: 0\.[0-9]+ s" "steady state logged"
+
+# Rising temperature is not steady
+(for t in $(seq 40000 1000 80000); do echo $t > "$tmp/cpu"; sleep 0.05; done) &
+okx timeout 5s thermobench -O"$tmp/out.csv" -S"$tmp/cpu cpu" -p100 --steady-state=0.1,0.5 --time=1 -- sleep inf
+unlike "$(tail -n1 "$tmp/out.csv")" "^# Steady state" "rising temperature not steady"
+wait
+
+thermobench -O/dev/null -S"$tmp/cpu cpu" --steady-state --steady-sensors=foo -- true 2>/dev/null
+is $? 1 "unknown sensor rejected"
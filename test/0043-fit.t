@@ -0,0 +1,25 @@
+#!/usr/bin/env bash
+. testlib
+plan_tests 7
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+echo 40000 > "$tmp/cpu"
+
+okx timeout 5s thermobench -O"$tmp/out.csv" -S"$tmp/cpu cpu" -p100 --fit --time=1 -- sleep inf
+like "$(tail -n1 "$tmp/out.csv")" "^# Fit cpu: Tinf: 40.00 °C, Tinf_stderr: [-0-9.e]+ °C, k: " "fit results stored"
+
+okx timeout 5s thermobench -O"$tmp/out.csv" -S"$tmp/cpu cpu" -p50 --fit-stop=0.1 -- sleep inf
+like "$(tail -n1 "$tmp/out.csv")" "^# Fit cpu: Tinf: 40.00 °C" "terminated by --fit-stop"
+
+# The sensor follows T(t) = 60 - 20·exp(-t/1 s) °C since COMMAND start
+echo 40000 > "$tmp/cpu"
+heat='start=$EPOCHREALTIME
+while :; do
+    awk -v t0=$start -v t=$EPOCHREALTIME "BEGIN { print int(1000 * (60 - 20 * exp(-(t - t0)))) }" > "$0.new"
+    mv "$0.new" "$0"
+done'
+okx timeout 10s thermobench -O"$tmp/out.csv" -S"$tmp/cpu cpu" -p50 --fit --time=3 -- bash -c "$heat" "$tmp/cpu"
+fit=$(tail -n1 "$tmp/out.csv")
+okx awk -v x="$(sed -ne 's/.*Tinf: \([-0-9.]*\) °C,.*/\1/p' <<<"$fit")" 'BEGIN { exit !(x > 59 && x < 61) }'
+okx awk -v x="$(sed -ne 's/.*tau: \([-0-9.]*\) s,.*/\1/p' <<<"$fit")" 'BEGIN { exit !(x > 0.8 && x < 1.2) }'
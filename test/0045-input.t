@@ -0,0 +1,54 @@
+#!/usr/bin/env bash
+. testlib
+plan_tests 11
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+mkfifo "$tmp/fifo"
+# Write all lines at once (printf may write line by line)
+printf "a=1\nb=2\nother\n" > "$tmp/data"
+(cat "$tmp/data" > "$tmp/fifo") &
+out=$(thermobench -O- -s/dev/null --input="(a=,b=,rest)$tmp/fifo" -- sleep 0.3)
+ok $? "exit code"
+readarray -t line <<<$out
+is "${line[1]}" "time/ms,a,b,rest"
+like "${line[2]}" "^[0-9.]+,1,2,other$"
+
+echo "<(@mean:x=) $tmp/fifo" > "$tmp/sensors"
+printf "x=1\nx=5\n" > "$tmp/data"
+(cat "$tmp/data" > "$tmp/fifo") &
+out=$(thermobench -O- -s "$tmp/sensors" -p 200 -- sleep 0.5)
+ok $? "exit code"
+readarray -t line <<<$out
+is "${line[1]}" "time/ms,x_mean"
+is "$(grep -c ',3$' <<<$out)" 1 "mean value stored"
+
+out=$(thermobench -O- -s/dev/null --input="$tmp/sensors" -- true 2>&1)
+is $? 1 "regular file is rejected"
+
+if type python3 >/dev/null 2>&1; then
+    # Stand-in for utils/sensord: send one value per connection and
+    # close it to test reconnection
+    python3 -c '
+import socket, sys
+s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+s.bind(sys.argv[1])
+s.listen()
+for v in (21.5, 22):
+    c, _ = s.accept()
+    c.sendall(b"ambient=%g\n" % v)
+    c.close()
+' "$tmp/sock" &
+    server=$!
+    while [ ! -S "$tmp/sock" ]; do sleep 0.05; done
+    out=$(thermobench -O- -s/dev/null --input="(ambient=)$tmp/sock" -- sleep 1.5 2>/dev/null)
+    ok $? "exit code"
+    readarray -t line <<<$out
+    is "${line[1]}" "time/ms,ambient"
+    like "${line[2]}" "^[0-9.]+,21.5$" "value from the first connection"
+    like "${line[3]}" "^[0-9.]+,22$" "value after reconnection"
+    wait $server
+else
+    skip 0 "python3 missing" 4
+fi
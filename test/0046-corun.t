@@ -0,0 +1,20 @@
+#!/usr/bin/env bash
+. testlib
+plan_tests 7
+
+out=$(thermobench -O- -s/dev/null -c val --corun='a:echo val=1; sleep inf' --corun='b:echo val=2; sleep inf' \
+                  -- sh -c 'sleep 0.2; echo val=3')
+ok $? "exit code"
+is "$(echo "$out" | sed -ne 2p)" "time/ms,val,a_val,b_val" "prefixed columns"
+is "$(echo "$out" | sed -ne '3,$p' | grep -v '^#' | cut -d, -f2- | sort | tr '\n' ' ')" ",,2 ,1, 3,, " "values attributed"
+
+out=$(thermobench -O- -s/dev/null -l --corun='@0:grep Cpus_allowed_list /proc/self/status' \
+                  --affinity=0 -- sh -c 'grep Cpus_allowed_list /proc/self/status; sleep 0.2')
+like "$out" ',Cpus_allowed_list:[[:space:]]0,' "co-run affinity set"
+like "$out" ',,Cpus_allowed_list:[[:space:]]0' "COMMAND affinity set"
+
+thermobench -O/dev/null -s/dev/null --corun='x:true' --corun='x:true' -- true 2>/dev/null
+is $? 64 "duplicate names rejected"
+
+thermobench -O/dev/null -s/dev/null --affinity=1-0 -- true 2>/dev/null
+is $? 1 "invalid CPU list rejected"
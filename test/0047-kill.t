@@ -0,0 +1,23 @@
+#!/usr/bin/env bash
+. testlib
+plan_tests 7
+
+out=$(thermobench -O- -s/dev/null -- sh -c 'exit 3' 2>/dev/null)
+is $? 3 "exit status propagated"
+like "$(tail -n1 <<<$out)" "^# Benchmark exit status: 3, max. RSS: [0-9]+ kB, user time: [0-9.]+ s, system time: [0-9.]+ s$" "exit status and rusage stored"
+
+# Benchmark ignoring SIGTERM is killed with SIGKILL
+out=$(timeout 5s thermobench -O- -s/dev/null --time=1 --kill-timeout=0.5 -- sh -c 'trap "" TERM; sleep inf' 2>/dev/null)
+ok $? "exit code"
+like "$(tail -n1 <<<$out)" "^# Benchmark killed by signal: Killed" "SIGKILL sent after timeout"
+
+out=$(timeout 5s thermobench -O- -s/dev/null --time=1 -- sleep inf 2>/dev/null)
+like "$(tail -n1 <<<$out)" "^# Benchmark killed by signal: Terminated" "SIGTERM sent by --time"
+
+# Daemon escaping from the benchmark process group does not block us
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+okx timeout 5s thermobench -O/dev/null -s/dev/null -- sh -c "setsid sh -c 'echo \$\$ > $tmp/pid; exec sleep inf' & sleep 0.2"
+sleep 0.1
+! kill -0 "$(cat "$tmp/pid")" 2>/dev/null
+ok $? "escaped process killed"
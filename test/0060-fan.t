@@ -0,0 +1,23 @@
+#!/usr/bin/env bash
+. testlib
+plan_tests 7
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+echo 20000 > "$tmp/temp"
+
+thermobench -O/dev/null -S"$tmp/temp" --wait=30 --fan-cmd="echo >> $tmp/fan1" -- true 2>/dev/null
+ok $? "exit code"
+is "$(echo $(cat "$tmp/fan1"))" "1 0" "fan on during cool-down, off after"
+
+thermobench -O/dev/null -S"$tmp/temp" --wait=30 --wait-period=100 --fan-on=0.5 --fan-stdin \
+            --fan-cmd="while read s; do echo \$s >> $tmp/fan2; echo ok; done" -- true 2>/dev/null
+ok $? "exit code"
+is "$(echo $(cat "$tmp/fan2"))" "1 0.5" "speeds sent to fan command stdin"
+
+out=$(thermobench -O/dev/null -S"$tmp/temp" -v --fan-on --fan-stdin --fan-cmd="while read s; do echo ok; done" -- true 2>&1)
+ok $? "exit code"
+like "$out" "Fan speed set to 1 in [0-9.]+ ms" "fan command timing reported"
+
+thermobench -O/dev/null -S"$tmp/temp" --fan-on --fan-stdin --fan-cmd="read s" -- true 2>/dev/null
+is $? 1 "missing acknowledgment is an error"
@@ -0,0 +1,30 @@
+#!/usr/bin/env bash
+. testlib
+plan_tests 9
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+echo 31500 > "$tmp/cpu"
+echo 20000 > "$tmp/gpu"
+
+thermobench -O"$tmp/out.csv" -S"$tmp/cpu cpu" -S"$tmp/gpu gpu" --wait=30 --wait-period=100 --wait-timeout=1 -- true 2>/dev/null
+ok $? "exit code"
+like "$(sed -ne 2p "$tmp/out.csv")" "^# Cool-down: target: 30°C, sensors: cpu, result: timeout" "timeout logged"
+
+thermobench -O"$tmp/out.csv" -S"$tmp/cpu cpu" -S"$tmp/gpu gpu" --wait=30 --wait-period=100 \
+            --wait-stable=2,1,0.3 --wait-sensors=all -- true 2>/dev/null
+ok $? "exit code"
+like "$(sed -ne 2p "$tmp/out.csv")" "^# Cool-down: target: 30°C, sensors: cpu gpu, result: done" "stable temperature accepted"
+is "$(grep -c '^# [0-9]' "$tmp/out.csv")" 4 "trajectory logged"
+
+echo 35000 > "$tmp/cpu"
+thermobench -O/dev/null -S"$tmp/cpu" --wait=30 --wait-period=100 --wait-timeout=1 --wait-pid=0.1 \
+            --fan-cmd="echo >> $tmp/fan" -- true 2>/dev/null
+ok $? "exit code"
+is "$(echo $(cat "$tmp/fan"))" "0.5 0" "fan speed set by PID controller"
+
+thermobench -S"$tmp/cpu" --wait=30 --wait-pid=0.1 -- true 2>/dev/null
+is $? 64 "--wait-pid requires --fan-cmd"
+
+thermobench -S"$tmp/cpu" --wait=30 --wait-sensors=foo -- true 2>/dev/null
+is $? 1 "unknown sensor rejected"
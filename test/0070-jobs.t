@@ -0,0 +1,47 @@
+#!/usr/bin/env bash
+. testlib
+plan_tests 12
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+echo 30000 > "$tmp/cpu"
+cat > "$tmp/jobs" <<JOBS
+# Parameters and jobs
+n = 1 2
+greet-{n}*2: echo val={n}
+other: echo "a, b"
+JOBS
+
+out=$(thermobench -S"$tmp/cpu cpu" -c val -o "$tmp" --jobs="$tmp/jobs" 2>&1)
+ok $? "exit code"
+like "$out" "Job 5/5: other" "all jobs run"
+is "$(cut -d, -f1-3 "$tmp/index.csv" | tr '\n' ' ')" \
+   "job,repetition,file greet-1,1,$tmp/greet-1-1.csv greet-1,2,$tmp/greet-1-2.csv greet-2,1,$tmp/greet-2-1.csv greet-2,2,$tmp/greet-2-2.csv other,1,$tmp/other.csv " \
+   "index written"
+like "$(tail -n1 "$tmp/index.csv")" ',"echo ""a, b"""$' "command escaped in index"
+is "$(sed -ne 2p "$tmp/greet-2-1.csv")" "# Job: greet-2, Repetition: 1/2, Command: echo val=2" "job info stored"
+is "$(grep -v '^#' "$tmp/greet-2-1.csv" | cut -d, -f3 | grep .)" "val
+2" "parameter substituted"
+
+echo "bad line" > "$tmp/jobs"
+thermobench -S"$tmp/cpu cpu" -o "$tmp" --jobs="$tmp/jobs" 2>/dev/null
+is $? 1 "invalid job file rejected"
+
+printf 'a: true\na: false\n' > "$tmp/jobs"
+thermobench -S"$tmp/cpu cpu" -o "$tmp" --jobs="$tmp/jobs" 2>/dev/null
+is $? 1 "duplicate job names rejected"
+
+thermobench -S"$tmp/cpu cpu" --jobs="$tmp/jobs" -- true 2>/dev/null
+is $? 64 "--jobs cannot be combined with COMMAND"
+
+printf 'a*2: true\na-1: true\n' > "$tmp/jobs"
+out=$(thermobench -S"$tmp/cpu cpu" -o "$tmp" --jobs="$tmp/jobs" 2>&1)
+is $? 1 "colliding output files rejected"
+like "$out" "Job 'a-1' would overwrite" "collision reported"
+
+cat > "$tmp/jobs" <<JOBS
+first: echo 40000 > $tmp/new && mv $tmp/new $tmp/cpu
+second: true
+JOBS
+thermobench -S"$tmp/cpu cpu" -o "$tmp" --jobs="$tmp/jobs" 2>/dev/null
+is "$(sed -ne 4p "$tmp/second.csv")" "0,40000" "replaced sensor file is reread"